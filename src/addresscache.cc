@@ -0,0 +1,81 @@
+#include "addresscache.hh"
+#include "application.hh"
+#include <ovlnet/logger.hh>
+#include <QCoreApplication>
+
+// Maximum number of cached addresses
+#define ADDRESSCACHE_SIZE           4096
+// Time (ms) until the confidence of an entry decays to 0
+#define ADDRESSCACHE_TTL            (1000*60*10)
+// Minimum confidence (in percent) of an entry to be used
+#define ADDRESSCACHE_MIN_CONFIDENCE 50
+
+
+AddressCache::AddressCache(Application &app, QObject *parent)
+  : QObject(parent), _application(app), _entries(ADDRESSCACHE_SIZE), _clock()
+{
+  _clock.start();
+  connect(&_application.dht(), SIGNAL(nodeReachable(NodeItem)),
+          this, SLOT(addReachable(NodeItem)));
+  if (QCoreApplication::instance()) {
+    connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()), this, SLOT(_onQuit()));
+  }
+}
+
+bool
+AddressCache::lookup(const Identifier &id, QHostAddress &addr, uint16_t &port) {
+  // QCache::object() also marks the entry as recently used
+  Entry *entry = _entries.object(id);
+  if ((0 == entry) || (_confidence(*entry) < ADDRESSCACHE_MIN_CONFIDENCE)) {
+    _application.metrics().increment(Metrics::ADDRESS_CACHE_MISSES);
+    return false;
+  }
+  _application.metrics().increment(Metrics::ADDRESS_CACHE_HITS);
+  addr = entry->addr; port = entry->port;
+  return true;
+}
+
+void
+AddressCache::add(const NodeItem &node, Source source) {
+  if (node.id() == _application.dht().id()) { return; }
+  Entry *entry = _entries.object(node.id());
+  // Do not replace a more confident entry by a less confident one
+  if (entry && (_confidence(*entry) > int(source))) { return; }
+  entry = new Entry();
+  entry->addr = node.addr();
+  entry->port = node.port();
+  entry->confidence = source;
+  entry->updated = _clock.elapsed();
+  _entries.insert(node.id(), entry);
+}
+
+void
+AddressCache::remove(const Identifier &id) {
+  _entries.remove(id);
+}
+
+void
+AddressCache::addReachable(const NodeItem &node) {
+  add(node, REACHABLE);
+}
+
+void
+AddressCache::addFound(const NodeItem &node) {
+  add(node, FOUND);
+}
+
+int
+AddressCache::_confidence(const Entry &entry) const {
+  qint64 age = _clock.elapsed() - entry.updated;
+  if (age >= ADDRESSCACHE_TTL) { return 0; }
+  return entry.confidence*(ADDRESSCACHE_TTL-age)/ADDRESSCACHE_TTL;
+}
+
+void
+AddressCache::_onQuit() {
+  Metrics &metrics = _application.metrics();
+  qint64 hits = metrics.count(Metrics::ADDRESS_CACHE_HITS);
+  qint64 misses = metrics.count(Metrics::ADDRESS_CACHE_MISSES);
+  logInfo() << "AddressCache: " << hits << " of " << (hits+misses)
+            << " lookups served from the cache.";
+}
@@ -0,0 +1,76 @@
+#ifndef ADDRESSCACHE_H
+#define ADDRESSCACHE_H
+
+#include <QObject>
+#include <QCache>
+#include <QElapsedTimer>
+#include <ovlnet/node.hh>
+
+// forward declarations
+class Application;
+
+
+/** A bounded LRU cache of node addresses, shared by all parts of the client. Every address
+ * learned (reachable nodes, lookup results) is kept with a confidence depending on its source.
+ * The confidence decays with the age of the entry. A node with a confident entry is pinged at
+ * that address instead of being looked up in the DHT. If it does not respond, the entry gets
+ * removed and the node is looked up. */
+class AddressCache : public QObject
+{
+  Q_OBJECT
+
+public:
+  /** The confidence of an address by its source. */
+  typedef enum {
+    /** Address reported by a successful lookup. */
+    FOUND = 80,
+    /** Node responded directly. */
+    REACHABLE = 100
+  } Source;
+
+public:
+  /** Constructor. */
+  explicit AddressCache(Application &app, QObject *parent=0);
+
+  /** Looks up the address of the given node. Returns @c true and sets @c addr and @c port if a
+   * confident entry exists. Counts hits and misses. */
+  bool lookup(const Identifier &id, QHostAddress &addr, uint16_t &port);
+  /** Adds or updates the address of a node. */
+  void add(const NodeItem &node, Source source);
+  /** Removes the address of a node (e.g., if a connection failed). */
+  void remove(const Identifier &id);
+
+public slots:
+  /** Adds a node that responded. */
+  void addReachable(const NodeItem &node);
+  /** Adds a node found by a lookup. */
+  void addFound(const NodeItem &node);
+
+protected slots:
+  /** Logs the cache statistics. */
+  void _onQuit();
+
+protected:
+  /** A cache entry. */
+  typedef struct {
+    QHostAddress addr;
+    uint16_t port;
+    /** Confidence in percent. */
+    int confidence;
+    /** Time of the last update (ms of the monotonic clock). */
+    qint64 updated;
+  } Entry;
+
+  /** Returns the confidence (in percent) of the given entry, decayed by its age. */
+  int _confidence(const Entry &entry) const;
+
+protected:
+  /** A weak reference to the application. */
+  Application &_application;
+  /** The entries. */
+  QCache<Identifier, Entry> _entries;
+  /** Monotonic clock for the age of the entries. */
+  QElapsedTimer _clock;
+};
+
+#endif // ADDRESSCACHE_H
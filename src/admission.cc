@@ -0,0 +1,155 @@
+#include "admission.hh"
+#include "application.hh"
+#include <ovlnet/logger.hh>
+#include <QtEndian>
+#include <cstring>
+
+// Delay (ms) between two attempts to delete replaced tables
+#define ADMISSION_RECLAIM_DELAY 1000
+
+
+/* ********************************************************************************************* *
+ * Implementation of AdmissionTable
+ * ********************************************************************************************* */
+AdmissionTable::AdmissionTable(const QHash<Identifier, unsigned> &entries)
+  : _size(0), _mask(0), _slots()
+{
+  // Keep the load factor below 1/2
+  size_t n = 8;
+  while (n < size_t(2*entries.size())) { n *= 2; }
+  _mask = n-1;
+  Slot empty; empty.flags = 0; memset(empty.id, 0, OVL_HASH_SIZE);
+  _slots.fill(empty, n);
+
+  QHash<Identifier, unsigned>::const_iterator entry = entries.begin();
+  for (; entry != entries.end(); entry++) {
+    // Skip malformed identifiers and entries without flags
+    if ((OVL_HASH_SIZE != entry.key().size()) || (0 == entry.value())) { continue; }
+    size_t i = _slot(entry.key().constData());
+    while (_slots[i].flags) { i = (i+1) & _mask; }
+    _slots[i].flags = entry.value();
+    memcpy(_slots[i].id, entry.key().constData(), OVL_HASH_SIZE);
+    _size++;
+  }
+}
+
+size_t
+AdmissionTable::size() const {
+  return _size;
+}
+
+inline size_t
+AdmissionTable::_slot(const char *id) const {
+  // Identifiers are hashes, hence their leading bytes are already uniformly distributed.
+  return qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(id)) & _mask;
+}
+
+unsigned
+AdmissionTable::flags(const Identifier &id) const {
+  if (OVL_HASH_SIZE != id.size()) { return 0; }
+  const Slot *slots = _slots.constData();
+  size_t i = _slot(id.constData());
+  while (slots[i].flags) {
+    if (0 == memcmp(slots[i].id, id.constData(), OVL_HASH_SIZE)) {
+      return slots[i].flags;
+    }
+    i = (i+1) & _mask;
+  }
+  return 0;
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of Admission
+ * ********************************************************************************************* */
+Admission::Admission(Application &app, QObject *parent)
+  : QObject(parent), _application(app), _current(0), _readers(0), _retired(), _updateTimer(),
+    _reclaimTimer()
+{
+  // Bulk changes (e.g. applying the whitelist) trigger a single rebuild
+  _updateTimer.setInterval(0);
+  _updateTimer.setSingleShot(true);
+  connect(&_updateTimer, SIGNAL(timeout()), this, SLOT(update()));
+  _reclaimTimer.setInterval(ADMISSION_RECLAIM_DELAY);
+  _reclaimTimer.setSingleShot(true);
+  connect(&_reclaimTimer, SIGNAL(timeout()), this, SLOT(_onReclaim()));
+
+  // Rebuild table on changes of the buddy list or the whitelist
+  connect(&_application.buddies(), SIGNAL(rowsInserted(QModelIndex,int,int)),
+          &_updateTimer, SLOT(start()));
+  connect(&_application.buddies(), SIGNAL(rowsRemoved(QModelIndex,int,int)),
+          &_updateTimer, SLOT(start()));
+  connect(&_application.buddies(), SIGNAL(modelReset()), &_updateTimer, SLOT(start()));
+  connect(&_application.settings().socksServiceSettings(), SIGNAL(modified()),
+          &_updateTimer, SLOT(start()));
+
+  update();
+}
+
+Admission::~Admission() {
+  // The services are gone by now, hence there are no readers left
+  while (! _retired.isEmpty()) {
+    delete _retired.takeFirst();
+  }
+  delete _current.loadAcquire();
+}
+
+unsigned
+Admission::flags(const Identifier &id) const {
+  // Announce reader before loading the table (full barrier), see _onReclaim()
+  _readers.fetchAndAddOrdered(1);
+  unsigned flags = _current.loadAcquire()->flags(id);
+  _readers.fetchAndAddOrdered(-1);
+  return flags;
+}
+
+bool
+Admission::isBuddy(const Identifier &id) const {
+  return AdmissionTable::BUDDY & flags(id);
+}
+
+bool
+Admission::isWhitelisted(const Identifier &id) const {
+  return AdmissionTable::WHITELISTED & flags(id);
+}
+
+void
+Admission::update() {
+  QHash<Identifier, unsigned> entries;
+  // Collect buddy nodes
+  BuddyList &buddies = _application.buddies();
+  for (size_t i=0; i<buddies.numBuddies(); i++) {
+    BuddyList::Buddy::const_iterator node = buddies.getBuddy(i)->begin();
+    for (; node != buddies.getBuddy(i)->end(); node++) {
+      entries[(*node)->id()] |= AdmissionTable::BUDDY;
+    }
+  }
+
+  // Collect whitelisted nodes
+  const SocksServiceSettings &socks = _application.settings().socksServiceSettings();
+  NodeIdList::const_iterator node = socks.whitelist().begin();
+  for (; node != socks.whitelist().end(); node++) {
+    entries[*node] |= AdmissionTable::WHITELISTED;
+  }
+
+  const AdmissionTable *table = new AdmissionTable(entries);
+  const AdmissionTable *old = _current.fetchAndStoreOrdered(table);
+  logDebug() << "Admission: Updated table with " << table->size() << " nodes.";
+  if (old) {
+    _retired.append(old);
+    _reclaimTimer.start();
+  }
+}
+
+void
+Admission::_onReclaim() {
+  // The table was replaced (full barrier) before this check. A reader counted after the check
+  // loads the new table, hence the retired ones are unreachable if there is no reader now.
+  if (0 != _readers.loadAcquire()) {
+    _reclaimTimer.start();
+    return;
+  }
+  while (! _retired.isEmpty()) {
+    delete _retired.takeFirst();
+  }
+}
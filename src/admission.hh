@@ -0,0 +1,100 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <QObject>
+#include <QVector>
+#include <QHash>
+#include <QList>
+#include <QTimer>
+#include <QAtomicPointer>
+#include <QAtomicInt>
+#include <ovlnet/buckets.hh>
+#include <ovlnet/dht_config.hh>
+
+class Application;
+
+
+/** An immutable hash table of node identifiers and their admission flags. The table uses open
+ * addressing with linear probing. Each slot holds the complete identifier, hence a lookup
+ * usually touches a single cache line. */
+class AdmissionTable
+{
+public:
+  /** Admission flags of a node. */
+  typedef enum {
+    BUDDY       = 1, ///< The node belongs to a buddy.
+    WHITELISTED = 2  ///< The node is on the SOCKS whitelist.
+  } Flags;
+
+public:
+  /** Builds the table from the given identifiers and flags. */
+  explicit AdmissionTable(const QHash<Identifier, unsigned> &entries);
+
+  /** Returns the number of entries. */
+  size_t size() const;
+  /** Returns the flags of the given node or 0 if the node is not known. */
+  unsigned flags(const Identifier &id) const;
+
+protected:
+  /** Returns the (start) slot of the given identifier. */
+  inline size_t _slot(const char *id) const;
+
+protected:
+  /** A single slot of the table, a slot is empty if its flags are 0. */
+  typedef struct {
+    quint32 flags;
+    char id[OVL_HASH_SIZE];
+  } Slot;
+
+  /** The number of entries. */
+  size_t _size;
+  /** Size of the table - 1 (size is a power of 2). */
+  size_t _mask;
+  /** The slots. */
+  QVector<Slot> _slots;
+};
+
+
+/** Maintains the admission table (buddies and whitelisted nodes) of the client. The table is
+ * rebuilt whenever the buddy list or the SOCKS whitelist changes and is published atomically. Hence it can be consulted from any thread
+ * without locking. Readers announce themselves in a counter before loading the table, a
+ * replaced table is only deleted once the counter was observed to be 0 after the replacement. */
+class Admission : public QObject
+{
+  Q_OBJECT
+
+public:
+  /** Constructor. */
+  explicit Admission(Application &app, QObject *parent=0);
+  /** Destructor. */
+  virtual ~Admission();
+
+  /** Returns the admission flags of the given node. */
+  unsigned flags(const Identifier &id) const;
+  /** Returns @c true if the given node belongs to a buddy. */
+  bool isBuddy(const Identifier &id) const;
+  /** Returns @c true if the given node is on the SOCKS whitelist. */
+  bool isWhitelisted(const Identifier &id) const;
+
+public slots:
+  /** Rebuilds the admission table. */
+  void update();
+
+protected slots:
+  void _onReclaim();
+
+protected:
+  Application &_application;
+  /** The current table. */
+  QAtomicPointer<const AdmissionTable> _current;
+  /** Number of readers currently accessing a table. */
+  mutable QAtomicInt _readers;
+  /** Tables replaced by an update. They get deleted once no thread may access them anymore. */
+  QList<const AdmissionTable *> _retired;
+  /** Coalesces several modifications into a single update. */
+  QTimer _updateTimer;
+  /** Timer to retry deleting retired tables. */
+  QTimer _reclaimTimer;
+};
+
+#endif // ADMISSION_H
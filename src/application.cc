@@ -4,8 +4,9 @@
 #include "buddylistview.hh"
 #include "chatwindow.hh"
 #include "callwindow.hh"
-#include "filetransferdialog.hh"
+#include "transferwindow.hh"
 #include "settingsdialog.hh"
+#include "sockswindow.hh"
 
 #include <ovlnet/socks.hh>
 #include <ovlnet/logger.hh>
@@ -24,11 +25,19 @@
 #include <QJsonDocument>
 #include <QJsonArray>
 
+// Time (ms) a node contacted at its cached address has to respond before it gets looked up
+#define APPLICATION_PROBE_TIMEOUT 1000
+
 
 Application::Application(int &argc, char *argv[])
   : QApplication(argc, argv), _dht(0), _status(0), _settings(0),
-    _buddies(0), _bootstrapList(), _reconnectTimer()
+    _buddies(0), _admission(0), _snapshot(0), _bootstrapList(), _bootstrapper(0),
+    _netMonitor(0), _metrics(), _history(0), _exporter(0), _lookups(0), _addresses(0), _probe(0),
+    _transfers(0), _probes(), _probeTimer(), _startTime(), _wasConnected(false),
+    _buddySeen(false)
 {
+  _startTime.start();
+
   // Init PortAudio
   Pa_Initialize();
 
@@ -60,37 +69,63 @@ Application::Application(int &argc, char *argv[])
   // register services
   _dht->registerService("simplechat", new ChatService(*this));
   _dht->registerService("call", new CallService(*this));
+  _dht->registerService("fileupload", new FileTransferService(*this));
+
+  // Measure lookups
+  _lookups = new LookupMonitor(*this, nodeDir.canonicalPath()+"/lookups.csv", this);
+  // Share addresses of nodes seen
+  _addresses = new AddressCache(*this, this);
+  // Verify cached addresses before connecting
+  _probeTimer.setInterval(APPLICATION_PROBE_TIMEOUT/4);
+  _probeTimer.setSingleShot(false);
+  connect(&_probeTimer, SIGNAL(timeout()), this, SLOT(onProbeTimeout()));
+  connect(_dht, SIGNAL(nodeReachable(NodeItem)), this, SLOT(onNodeReachable(NodeItem)));
 
   // Load settings
   _settings = new Settings(nodeDir.canonicalPath()+"/settings.json");
 
-  // load a list of bootstrap servers.
+  // load a list of bootstrap servers and resolve them in the background.
   _bootstrapList = BootstrapNodeList(nodeDir.canonicalPath()+"/bootstrap.json");
-  QPair<QString, uint16_t> hostport;
-  foreach (hostport, _bootstrapList) {
-    _dht->ping(hostport.first, hostport.second);
-  }
+  _bootstrapper = new Bootstrapper(*_dht, _bootstrapList, this);
 
-  // Create DHT status object
-  _status = new DHTStatus(*this);
   // Create buddy list model
   _buddies = new BuddyList(*this, nodeDir.canonicalPath()+"/buddies.json");
+  // Create admission table for incoming connections
+  _admission = new Admission(*this);
+  // Create DHT status object
+  _status = new DHTStatus(*this);
+  // Record history of node and client metrics
+  _history = new MetricsHistory(*this, this);
+  // Export metrics (if enabled)
+  _exporter = new MetricsExporter(*this, this);
+  // Measure the delay of events (e.g., packets) in the GUI thread
+  _probe = new EventLoopProbe(_metrics, this);
+  // Contact buddy nodes and peers known from the last session
+  _snapshot = new Snapshot(*this, nodeDir.canonicalPath()+"/snapshot.dat");
+  _snapshot->restore();
+  // Queue and run file transfers
+  _transfers = new TransferManager(*this);
 
   // Actions
   _search      = new QAction(QIcon("://icons/search.png"), tr("Search ..."), this);
   _showBuddies = new QAction(QIcon("://icons/people.png"), tr("Contacts ..."), this);
   _bootstrap   = new QAction(QIcon("://icons/bootstrap.png"), tr("Bootstrap ..."), this);
   _showStatus  = new QAction(QIcon("://icons/dashboard.png"), tr("Show status ..."), this);
+  _showTransfers = new QAction(QIcon("://icons/data-transfer-download.png"),
+                               tr("File transfers ..."), this);
   _showSettings = new QAction(QIcon("://icons/wrench.png"), tr("Settings ..."), this);
   _quit        = new QAction(QIcon("://icons/power-standby.png"), tr("Quit"), this);
 
   _searchWindow = 0;
   _buddyListWindow = 0;
   _statusWindow = 0;
+  _socksWindow = 0;
+  _transferWindow = 0;
 
   QMenu *ctx = new QMenu();
   ctx->addAction(_search);
   ctx->addAction(_showBuddies);
+  ctx->addAction(_showTransfers);
   ctx->addSeparator();
   ctx->addAction(_bootstrap);
   ctx->addAction(_showStatus);
@@ -108,28 +143,33 @@ Application::Application(int &argc, char *argv[])
   _trayIcon->setContextMenu(ctx);
   _trayIcon->show();
 
-  // setup reconnect timer
-  _reconnectTimer.setInterval(1000*60);
-  _reconnectTimer.setSingleShot(false);
+  // Start bootstrapping, continues on connection loss
   if (0 == _dht->numNodes()) {
-    _reconnectTimer.start();
+    _bootstrapper->start();
   }
+  // Reconnect immediately on network changes
+  _netMonitor = new NetworkMonitor(this);
 
   // Connect to signals
   connect(_dht, SIGNAL(connected()), this, SLOT(onDHTConnected()));
   connect(_dht, SIGNAL(disconnected()), this, SLOT(onDHTDisconnected()));
+  connect(_buddies, SIGNAL(appeared(Identifier)), this, SLOT(onBuddyAppeared(Identifier)));
+  connect(_netMonitor, SIGNAL(changed()), this, SLOT(onNetworkChanged()));
 
   connect(_search, SIGNAL(triggered()), this, SLOT(search()));
   connect(_showBuddies, SIGNAL(triggered()), this, SLOT(onShowBuddies()));
   connect(_bootstrap, SIGNAL(triggered()), this, SLOT(onBootstrap()));
   connect(_showSettings, SIGNAL(triggered()), this, SLOT(onShowSettings()));
   connect(_showStatus, SIGNAL(triggered()), this, SLOT(onShowStatus()));
+  connect(_showTransfers, SIGNAL(triggered()), this, SLOT(onShowTransfers()));
+  // Show incoming transfers to be accepted
+  connect(_transfers, SIGNAL(requested()), this, SLOT(onShowTransfers()));
   connect(_quit, SIGNAL(triggered()), this, SLOT(onQuit()));
-
-  connect(&_reconnectTimer, SIGNAL(timeout()), this, SLOT(onReconnect()));
 }
 
 Application::~Application() {
+  // Transfers release their pending streams
+  delete _transfers;
   Pa_Terminate();
 }
 
@@ -151,8 +191,7 @@ Application::onBootstrap() {
       host = parts.front();
       port = parts.back().toUInt();
     }
-    _dht->ping(host, port);
-    _bootstrapList.insert(host, port);
+    _bootstrapper->add(host, port);
     return;
   }
 }
@@ -162,7 +201,7 @@ Application::search() {
   if (_searchWindow) {
     _searchWindow->activateWindow();
   } else {
-    _searchWindow = new SearchDialog(_dht, _buddies);
+    _searchWindow = new SearchDialog(*this);
     _searchWindow->show();
     QObject::connect(_searchWindow, SIGNAL(destroyed()), this, SLOT(onSearchWindowClosed()));
   }
@@ -219,6 +258,42 @@ Application::onStatusWindowClosed() {
   _statusWindow = 0;
 }
 
+void
+Application::startProxy(const NodeItem &node) {
+  if (0 == _socksWindow) {
+    _socksWindow = new SocksWindow(*this);
+    QObject::connect(_socksWindow, SIGNAL(destroyed()), this, SLOT(onSocksWindowClosed()));
+  }
+  _socksWindow->addTunnel(node);
+  _socksWindow->show();
+  _socksWindow->activateWindow();
+  _socksWindow->raise();
+}
+
+void
+Application::onSocksWindowClosed() {
+  _socksWindow = 0;
+}
+
+void
+Application::onShowTransfers() {
+  if (_transferWindow) {
+    _transferWindow->activateWindow();
+    _transferWindow->raise();
+  } else {
+    _transferWindow = new TransferWindow(*this);
+    _transferWindow->show();
+    _transferWindow->raise();
+    QObject::connect(_transferWindow, SIGNAL(destroyed()),
+                     this, SLOT(onTransferWindowClosed()));
+  }
+}
+
+void
+Application::onTransferWindowClosed() {
+  _transferWindow = 0;
+}
+
 void
 Application::onQuit() {
   quit();
@@ -230,11 +305,7 @@ Application::startChatWith(const Identifier &id) {
   // Add id to list of pending chats
   _pendingStreams.insert(id, new SecureChat(dht()));
   // First search node
-  FindNodeQuery *query = new FindNodeQuery(id);
-  connect(query, SIGNAL(found(NodeItem)), this, SLOT(onNodeFound(NodeItem)));
-  connect(query, SIGNAL(failed(Identifier,QList<NodeItem>)),
-          this, SLOT(onNodeNotFound(Identifier,QList<NodeItem>)));
-  _dht->search(query);
+  _findNode(id, Metrics::LOOKUP_CHAT);
 }
 
 void
@@ -242,23 +313,64 @@ Application::call(const Identifier &id) {
   // Add id to list of pending calls
   _pendingStreams.insert(id, new SecureCall(false, dht()));
   // First search node
-  FindNodeQuery *query = new FindNodeQuery(id);
-  connect(query, SIGNAL(found(NodeItem)), this, SLOT(onNodeFound(NodeItem)));
-  connect(query, SIGNAL(failed(Identifier,QList<NodeItem>)),
-          this, SLOT(onNodeNotFound(Identifier,QList<NodeItem>)));
-  _dht->search(query);
+  _findNode(id, Metrics::LOOKUP_CALL);
 }
 
 void
-Application::sendFile(const QString &path, size_t size, const Identifier &id) {
+Application::sendFiles(const QStringList &paths, const Identifier &id) {
+  // Files get packed first, then the transfer waits for a free slot
+  _transfers->upload(paths, id);
+  onShowTransfers();
+}
+
+void
+Application::connectUpload(FileUpload *upload, const Identifier &id) {
   // Add id to list of pending file transfers
-  _pendingStreams.insert(id, new FileUpload(dht(), path, size));
+  _pendingStreams.insert(id, upload);
   // First search node
+  _findNode(id, Metrics::LOOKUP_FILE);
+}
+
+bool
+Application::isPending(const Identifier &id) const {
+  return _pendingStreams.contains(id);
+}
+
+bool
+Application::cancelStream(SecureSocket *stream) {
+  QHash<Identifier, SecureSocket *>::iterator item = _pendingStreams.begin();
+  for (; item != _pendingStreams.end(); item++) {
+    if (stream == item.value()) {
+      _pendingStreams.erase(item);
+      return true;
+    }
+  }
+  return false;
+}
+
+void
+Application::_findNode(const Identifier &id, Metrics::Lookup origin) {
+  // Ping a recently seen node at its cached address, connect directly once it responds
+  QHostAddress addr; uint16_t port;
+  if (_addresses->lookup(id, addr, port)) {
+    Probe probe; probe.sent = _startTime.elapsed(); probe.origin = origin;
+    _probes.insert(id, probe);
+    _dht->ping(addr, port);
+    if (! _probeTimer.isActive()) {
+      _probeTimer.start();
+    }
+    return;
+  }
+  _search(id, origin);
+}
+
+void
+Application::_search(const Identifier &id, Metrics::Lookup origin) {
   FindNodeQuery *query = new FindNodeQuery(id);
   connect(query, SIGNAL(found(NodeItem)), this, SLOT(onNodeFound(NodeItem)));
   connect(query, SIGNAL(failed(Identifier,QList<NodeItem>)),
           this, SLOT(onNodeNotFound(Identifier,QList<NodeItem>)));
-  _dht->search(query);
+  _lookups->search(query, origin);
 }
 
 Node &
@@ -286,6 +398,36 @@ Application::status() {
   return *_status;
 }
 
+Admission &
+Application::admission() {
+  return *_admission;
+}
+
+Metrics &
+Application::metrics() {
+  return _metrics;
+}
+
+MetricsHistory &
+Application::history() {
+  return *_history;
+}
+
+LookupMonitor &
+Application::lookups() {
+  return *_lookups;
+}
+
+AddressCache &
+Application::addresses() {
+  return *_addresses;
+}
+
+TransferManager &
+Application::transfers() {
+  return *_transfers;
+}
+
 bool
 Application::started() const {
   return (_dht && _dht->started());
@@ -313,7 +455,7 @@ Application::onNodeFound(const NodeItem &node) {
     (new CallWindow(*this, call))->show();
     _dht->startConnection("call", node, stream);
   } else if (0 != (upload = dynamic_cast<FileUpload *>(stream))) {
-    logInfo() << "Node " << node.id() << "found: Start upload of file " << upload->fileName();
+    logInfo() << "Node " << node.id() << " found: Start upload of file " << upload->fileName();
     _dht->startConnection("fileupload", node, stream);
   }
 }
@@ -321,39 +463,81 @@ Application::onNodeFound(const NodeItem &node) {
 void
 Application::onNodeNotFound(const Identifier &id, const QList<NodeItem> &best) {
   if (!_pendingStreams.contains(id)) { return; }
-  QMessageBox::critical(
-        0, tr("Can not initialize connection"),
+  // Called from within the packet handling of the node, do not block it by a modal dialog.
+  QMessageBox *msg = new QMessageBox(
+        QMessageBox::Critical, tr("Can not initialize connection"),
         tr("Can not initialize a secure connection to %1: not reachable.").arg(QString(id.toHex())));
+  msg->setAttribute(Qt::WA_DeleteOnClose);
+  msg->show();
+  // Uploads are owned by the transfer manager, which also removes the pending stream
+  FileUpload *upload = dynamic_cast<FileUpload *>(_pendingStreams[id]);
+  if (upload) {
+    _transfers->notFound(upload);
+    return;
+  }
   // Free stream
   delete _pendingStreams[id];
   _pendingStreams.remove(id);
 }
 
+void
+Application::onNodeReachable(const NodeItem &node) {
+  if (! _probes.contains(node.id())) { return; }
+  // The node responded at its cached (or a new) address
+  _probes.remove(node.id());
+  onNodeFound(node);
+}
+
+void
+Application::onProbeTimeout() {
+  qint64 now = _startTime.elapsed();
+  QHash<Identifier, Probe>::iterator probe = _probes.begin();
+  while (probe != _probes.end()) {
+    if ((now - probe->sent) < APPLICATION_PROBE_TIMEOUT) { probe++; continue; }
+    // The cached address is stale, forget it and look up the node
+    Identifier id = probe.key();
+    Metrics::Lookup origin = probe->origin;
+    probe = _probes.erase(probe);
+    logDebug() << "Node " << id << " did not respond at its cached address, search it.";
+    _addresses->remove(id);
+    if (_pendingStreams.contains(id)) {
+      _search(id, origin);
+    }
+  }
+  if (_probes.isEmpty()) {
+    _probeTimer.stop();
+  }
+}
+
 void
 Application::onDHTConnected() {
   logInfo() << "Connected to overlay network.";
+  if (! _wasConnected) {
+    _wasConnected = true;
+    logInfo() << "Connected " << _startTime.elapsed() << "ms after startup.";
+  }
   _trayIcon->setIcon(QIcon("://icons/fork.png"));
-  _reconnectTimer.stop();
 }
 
 void
 Application::onDHTDisconnected() {
   logInfo() << "Lost connection to overlay network.";
   _trayIcon->setIcon(QIcon("://icons/fork_gray.png"));
-  _reconnectTimer.start();
 }
 
 void
-Application::onReconnect() {
-  if (_dht->numNodes()) {
-    onDHTConnected();
-  } else {
-    logInfo() << "Connect to overlay network...";
-    QPair<QString, uint16_t> hostport;
-    foreach (hostport, _bootstrapList) {
-      _dht->ping(hostport.first, hostport.second);
-    }
-  }
+Application::onBuddyAppeared(const Identifier &id) {
+  if (_buddySeen) { return; }
+  _buddySeen = true;
+  logInfo() << "First buddy online " << _startTime.elapsed() << "ms after startup.";
+}
+
+void
+Application::onNetworkChanged() {
+  logInfo() << "Network changed: Reconnect to overlay network.";
+  // Announce new address and re-check all buddy nodes at once
+  _bootstrapper->start();
+  _buddies->revalidate();
 }
 
 
@@ -374,7 +558,7 @@ Application::ChatService::newSocket() {
 
 bool
 Application::ChatService::allowConnection(const NodeItem &peer) {
-  return _application._buddies->hasNode(peer.id());
+  return _application._admission->isBuddy(peer.id());
 }
 
 void
@@ -405,7 +589,7 @@ Application::CallService::newSocket() {
 
 bool
 Application::CallService::allowConnection(const NodeItem &peer) {
-  return _application._buddies->hasNode(peer.id());
+  return _application._admission->isBuddy(peer.id());
 }
 
 void
@@ -418,3 +602,35 @@ void
 Application::CallService::connectionFailed(SecureSocket *socket) {
   logDebug() << "Application: Call connection failed!";
 }
+
+
+/* ********************************************************************************************* *
+ * Implementation of FileTransferService
+ * ********************************************************************************************* */
+Application::FileTransferService::FileTransferService(Application &app)
+  : AbstractService(), _application(app)
+{
+  // pass...
+}
+
+SecureSocket *
+Application::FileTransferService::newSocket() {
+  logDebug() << "Application: Create new FileDownload instance.";
+  return new FileDownload(_application.dht());
+}
+
+bool
+Application::FileTransferService::allowConnection(const NodeItem &peer) {
+  return _application._admission->isBuddy(peer.id());
+}
+
+void
+Application::FileTransferService::connectionStarted(SecureSocket *socket) {
+  // The transfer manager asks for acceptance once the request is received
+  _application.transfers().download(dynamic_cast<FileDownload *>(socket));
+}
+
+void
+Application::FileTransferService::connectionFailed(SecureSocket *socket) {
+  logDebug() << "Application: File transfer connection failed!";
+}
@@ -6,14 +6,27 @@
 #include <QAction>
 #include <QStringList>
 #include <QTimer>
+#include <QElapsedTimer>
 
 #include <ovlnet.hh>
 #include "dhtstatus.hh"
 #include "buddylist.hh"
 #include "bootstrapnodelist.hh"
+#include "bootstrapper.hh"
+#include "netmonitor.hh"
 #include "logwindow.hh"
 #include "settings.hh"
-
+#include "admission.hh"
+#include "snapshot.hh"
+#include "metrics.hh"
+#include "history.hh"
+#include "exporter.hh"
+#include "lookupmonitor.hh"
+#include "addresscache.hh"
+#include "eventloopprobe.hh"
+#include "transfermanager.hh"
+
+class SocksWindow;
 
 class Application : public QApplication
 {
@@ -27,8 +40,20 @@ public:
   void startChatWith(const Identifier &id);
   /** Initializes a voice call to the specified node. */
   void call(const Identifier &id);
-  /** Initializes a file transfer. */
-  void sendFile(const QString &path, size_t size, const Identifier &id);
+  /** Queues a file transfer of the given files or a single directory. All files are sent
+   * within one transfer. */
+  void sendFiles(const QStringList &paths, const Identifier &id);
+  /** Looks up the node and starts the given upload. The transfer manager gets notified if the
+   * node cannot be found. */
+  void connectUpload(FileUpload *upload, const Identifier &id);
+  /** Removes the given stream from the pending streams. Returns @c true if the stream was
+   * still pending. */
+  bool cancelStream(SecureSocket *stream);
+  /** Returns @c true if a stream to the given node waits for the node to be found. */
+  bool isPending(const Identifier &id) const;
+  /** Adds the given node as an exit node to the local SOCKS proxy (starts the proxy if
+   * needed). */
+  void startProxy(const NodeItem &node);
 
   /** Returns a weak reference to the DHT instance. */
   Node &dht();
@@ -40,6 +65,18 @@ public:
   LogModel &log();
   /** Returns the status model of the application. */
   DHTStatus &status();
+  /** Returns the admission table for incoming connections. */
+  Admission &admission();
+  /** Returns the counters of the client. */
+  Metrics &metrics();
+  /** Returns the recorded history of the node and client metrics. */
+  MetricsHistory &history();
+  /** Returns the lookup monitor, all node lookups should be started with. */
+  LookupMonitor &lookups();
+  /** Returns the cache of node addresses. */
+  AddressCache &addresses();
+  /** Returns the file transfers. */
+  TransferManager &transfers();
 
   /** Returns @c true if the OvlNet node was started successfully. */
   bool started() const;
@@ -57,12 +94,16 @@ protected slots:
   void onShowSettings();
   /** Callback for the "show DHT status" action. */
   void onShowStatus();
+  /** Callback for the "show transfers" action. */
+  void onShowTransfers();
   /** Callback for the "quit" action. */
   void onQuit();
 
   void onSearchWindowClosed();
   void onBuddyListClosed();
   void onStatusWindowClosed();
+  void onSocksWindowClosed();
+  void onTransferWindowClosed();
 
   /** Get notified if a node search was successful. */
   void onNodeFound(const NodeItem &node);
@@ -72,8 +113,21 @@ protected slots:
   void onDHTConnected();
   /** Get notified if the DHT lost the connection to the network. */
   void onDHTDisconnected();
-  /** Gets called periodically on connection loss to bootstrap a connection to the network. */
-  void onReconnect();
+  /** Get notified if a buddy node appeared. */
+  void onBuddyAppeared(const Identifier &id);
+  /** Get notified if the network configuration of the host changed. */
+  void onNetworkChanged();
+  /** Get notified if a node responded, completes pending probes of cached addresses. */
+  void onNodeReachable(const NodeItem &node);
+  /** Looks up nodes that did not respond at their cached address. */
+  void onProbeTimeout();
+
+protected:
+  /** Searches the given node, calls @c onNodeFound or @c onNodeNotFound. A node with a cached
+   * address gets pinged first and only looked up if it does not respond. */
+  void _findNode(const Identifier &id, Metrics::Lookup origin);
+  /** Looks up the given node in the DHT. */
+  void _search(const Identifier &id, Metrics::Lookup origin);
 
 protected:
   class ChatService: public AbstractService
@@ -100,6 +154,18 @@ protected:
     Application &_application;
   };
 
+  class FileTransferService: public AbstractService
+  {
+  public:
+    FileTransferService(Application &app);
+    SecureSocket *newSocket();
+    bool allowConnection(const NodeItem &peer);
+    void connectionStarted(SecureSocket *socket);
+    void connectionFailed(SecureSocket *socket);
+  protected:
+    Application &_application;
+  };
+
 protected:
   /** This DHT node. */
   Node *_dht;
@@ -109,29 +175,69 @@ protected:
   Settings *_settings;
   /** The buddy list. */
   BuddyList *_buddies;
+  /** Admission table (buddies and whitelisted nodes). */
+  Admission *_admission;
+  /** Snapshot of buddy node addresses and routing table peers. */
+  Snapshot *_snapshot;
   /** The list of bootstap servers. */
   BootstrapNodeList _bootstrapList;
+  /** Connects the node to the network. */
+  Bootstrapper *_bootstrapper;
+  /** Watches the network interfaces. */
+  NetworkMonitor *_netMonitor;
   /** Receives log messages. */
   LogModel *_logModel;
+  /** Counters of the client. */
+  Metrics _metrics;
+  /** History of the node and client metrics. */
+  MetricsHistory *_history;
+  /** Serves the metrics over HTTP (if enabled). */
+  MetricsExporter *_exporter;
+  /** Measures node lookups. */
+  LookupMonitor *_lookups;
+  /** Recently seen node addresses. */
+  AddressCache *_addresses;
+  /** Measures the delay of the event loop. */
+  EventLoopProbe *_probe;
+  /** All file transfers. */
+  TransferManager *_transfers;
 
   QAction *_showBuddies;
   QAction *_search;
   QAction *_bootstrap;
   QAction *_showSettings;
   QAction *_showStatus;
+  QAction *_showTransfers;
   QAction *_quit;
 
   QWidget *_searchWindow;
   QWidget *_buddyListWindow;
   QWidget *_statusWindow;
+  SocksWindow *_socksWindow;
+  QWidget *_transferWindow;
 
   /** Table of pending streams. */
   QHash<Identifier, SecureSocket *> _pendingStreams;
+  /** A node pinged at its cached address. */
+  typedef struct {
+    /** Time the ping was sent (ms since startup). */
+    qint64 sent;
+    /** The origin of the lookup, in case the node does not respond. */
+    Metrics::Lookup origin;
+  } Probe;
+  /** Nodes pinged at their cached address. */
+  QHash<Identifier, Probe> _probes;
+  /** Checks for nodes that did not respond. */
+  QTimer _probeTimer;
   /** The system tray icon. */
   QSystemTrayIcon *_trayIcon;
 
-  /** Once the connection to the network is lost, try to reconnect every minute. */
-  QTimer _reconnectTimer;
+  /** Measures the time since startup. */
+  QElapsedTimer _startTime;
+  /** Set once the node is connected for the first time. */
+  bool _wasConnected;
+  /** Set once the first buddy appeared. */
+  bool _buddySeen;
 };
 
 #endif // APPLICATION_H
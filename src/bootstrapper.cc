@@ -0,0 +1,208 @@
+#include "bootstrapper.hh"
+#include <ovlnet/logger.hh>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <algorithm>
+
+// Initial delay (ms) between two bootstrap attempts
+#define BOOTSTRAP_MIN_DELAY 1000
+// Maximum delay (ms) between two bootstrap attempts
+#define BOOTSTRAP_MAX_DELAY (1000*60)
+// Number of additional servers contacted with each attempt
+#define BOOTSTRAP_FANOUT    3
+
+
+/* ********************************************************************************************* *
+ * Implementation of Bootstrapper::Server
+ * ********************************************************************************************* */
+Bootstrapper::Server::Server(const QString &host, uint16_t port)
+  : host(host), port(port), addresses(), successes(0), failures(0), rtt(-1), ping()
+{
+  // pass...
+}
+
+double
+Bootstrapper::Server::score() const {
+  // Expected RTT, penalized by the failure rate
+  double expected = (rtt < 0) ? 1000 : rtt;
+  return expected * double(1+failures)/double(1+successes);
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of Bootstrapper
+ * ********************************************************************************************* */
+bool
+Bootstrapper::_better(const Server *a, const Server *b) {
+  return a->score() < b->score();
+}
+
+Bootstrapper::Bootstrapper(Node &dht, BootstrapNodeList &servers, QObject *parent)
+  : QObject(parent), _dht(dht), _list(servers), _servers(), _lookups(), _attempt(0), _timer(),
+    _random(0)
+{
+  // Seed the jitter per node and process, hence clients do not retry in lockstep
+  _random = qHash(_dht.id()) ^ uint(QDateTime::currentMSecsSinceEpoch())
+      ^ uint(QCoreApplication::applicationPid());
+  if (0 == _random) { _random = 1; }
+
+  _timer.setSingleShot(true);
+  connect(&_timer, SIGNAL(timeout()), this, SLOT(_onAttempt()));
+  connect(&_dht, SIGNAL(nodeReachable(NodeItem)), this, SLOT(_onNodeReachable(NodeItem)));
+  connect(&_dht, SIGNAL(connected()), this, SLOT(_onConnected()));
+  connect(&_dht, SIGNAL(disconnected()), this, SLOT(_onDisconnected()));
+
+  // Servers get resolved once bootstrapping starts
+  QPair<QString, uint16_t> hostport;
+  foreach (hostport, _list) {
+    _servers.append(new Server(hostport.first, hostport.second));
+  }
+}
+
+Bootstrapper::~Bootstrapper() {
+  QHash<int, Server *>::iterator lookup = _lookups.begin();
+  for (; lookup != _lookups.end(); lookup++) {
+    QHostInfo::abortHostLookup(lookup.key());
+  }
+  QVector<Server *>::iterator server = _servers.begin();
+  for (; server != _servers.end(); server++) {
+    delete *server;
+  }
+}
+
+void
+Bootstrapper::add(const QString &host, uint16_t port) {
+  _list.insert(host, port);
+  for (int i=0; i<_servers.size(); i++) {
+    if ((_servers[i]->host == host) && (_servers[i]->port == port)) {
+      _ping(_servers[i]); return;
+    }
+  }
+  Server *server = new Server(host, port);
+  _servers.append(server);
+  // Gets pinged once resolved
+  _resolve(server);
+}
+
+bool
+Bootstrapper::isActive() const {
+  return _timer.isActive();
+}
+
+void
+Bootstrapper::start() {
+  logDebug() << "Bootstrapper: Connect to overlay network...";
+  _attempt = 0;
+  // Addresses may have changed, the cached ones are used until the lookups are done
+  for (int i=0; i<_servers.size(); i++) {
+    _resolve(_servers[i]);
+  }
+  _onAttempt();
+}
+
+void
+Bootstrapper::stop() {
+  _timer.stop();
+}
+
+void
+Bootstrapper::_resolve(Server *server) {
+  // Skip servers with a pending lookup
+  if (_lookups.values().contains(server)) { return; }
+  int id = QHostInfo::lookupHost(server->host, this, SLOT(_onHostResolved(QHostInfo)));
+  _lookups.insert(id, server);
+}
+
+double
+Bootstrapper::_jitter() {
+  // xorshift32, the state is never 0
+  _random ^= _random << 13;
+  _random ^= _random >> 17;
+  _random ^= _random << 5;
+  return double(_random)/4294967296.0;
+}
+
+void
+Bootstrapper::_ping(Server *server) {
+  if (server->addresses.isEmpty()) { return; }
+  server->ping.start();
+  foreach (QHostAddress addr, server->addresses) {
+    _dht.ping(addr, server->port);
+  }
+}
+
+void
+Bootstrapper::_onHostResolved(const QHostInfo &info) {
+  if (! _lookups.contains(info.lookupId())) { return; }
+  Server *server = _lookups.take(info.lookupId());
+  if (QHostInfo::NoError != info.error()) {
+    logWarning() << "Bootstrapper: Cannot resolve " << server->host << ": " << info.errorString();
+    return;
+  }
+  bool known = ! server->addresses.isEmpty();
+  server->addresses = info.addresses();
+  // Contact new servers or servers resolved for the first time immediately
+  if ((! known) && (isActive() || (0 == _dht.numNodes()))) {
+    _ping(server);
+  }
+}
+
+void
+Bootstrapper::_onNodeReachable(const NodeItem &node) {
+  for (int i=0; i<_servers.size(); i++) {
+    Server *server = _servers[i];
+    if ((server->port != node.port()) || (! server->addresses.contains(node.addr()))) {
+      continue;
+    }
+    if (! server->ping.isValid()) { return; }
+    double rtt = server->ping.elapsed();
+    if (server->rtt < 0) { server->rtt = rtt; }
+    else { server->rtt = 0.875*server->rtt + 0.125*rtt; }
+    server->successes++;
+    server->ping.invalidate();
+    return;
+  }
+}
+
+void
+Bootstrapper::_onConnected() {
+  stop();
+}
+
+void
+Bootstrapper::_onDisconnected() {
+  start();
+}
+
+void
+Bootstrapper::_onAttempt() {
+  // The first attempt is made even if connected (e.g., to announce a new address)
+  if (_attempt && _dht.numNodes()) { stop(); return; }
+
+  // Count unanswered pings of the last attempt
+  QVector<Server *> ranked = _servers;
+  for (int i=0; i<ranked.size(); i++) {
+    if (ranked[i]->ping.isValid()) {
+      ranked[i]->failures++;
+      ranked[i]->ping.invalidate();
+    }
+  }
+
+  // Contact the best servers first, then more with each attempt
+  std::sort(ranked.begin(), ranked.end(), _better);
+  int n = std::min(ranked.size(), BOOTSTRAP_FANOUT*(_attempt+1));
+  for (int i=0; i<n; i++) {
+    _ping(ranked[i]);
+  }
+
+  // Schedule next attempt with exponential backoff and jitter of +/-50%
+  qint64 delay = BOOTSTRAP_MAX_DELAY;
+  if (_attempt < 16) {
+    delay = std::min(qint64(BOOTSTRAP_MIN_DELAY) << _attempt, qint64(BOOTSTRAP_MAX_DELAY));
+  }
+  delay = delay * (0.5 + _jitter());
+  _attempt++;
+  logDebug() << "Bootstrapper: Contacted " << n << " servers, next attempt in "
+             << delay << "ms.";
+  _timer.start(int(delay));
+}
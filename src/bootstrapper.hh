@@ -0,0 +1,98 @@
+#ifndef BOOTSTRAPPER_H
+#define BOOTSTRAPPER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QHostInfo>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QHash>
+#include <ovlnet/node.hh>
+#include "bootstrapnodelist.hh"
+
+
+/** Connects the DHT node to the network using the known bootstrap servers. The hostnames of
+ * all servers get resolved in parallel, the success rate and RTT of each server is tracked.
+ * Servers are contacted best first. If the node does not connect, the attempt is repeated
+ * with an exponential backoff plus some jitter. */
+class Bootstrapper : public QObject
+{
+  Q_OBJECT
+
+public:
+  /** Constructor.
+   * @param dht The DHT node to connect.
+   * @param servers The list of bootstrap servers, new servers are added to this list. */
+  Bootstrapper(Node &dht, BootstrapNodeList &servers, QObject *parent=0);
+  /** Destructor. */
+  virtual ~Bootstrapper();
+
+  /** Adds a bootstrap server to the list and contacts it immediately. */
+  void add(const QString &host, uint16_t port);
+
+  /** Returns @c true if a bootstrap is in progress. */
+  bool isActive() const;
+
+public slots:
+  /** Starts bootstrapping (again) immediately. The backoff gets reset and all hostnames get
+   * resolved (again). The best servers get contacted even if the node is connected. */
+  void start();
+  /** Stops bootstrapping. */
+  void stop();
+
+protected slots:
+  void _onHostResolved(const QHostInfo &info);
+  void _onNodeReachable(const NodeItem &node);
+  void _onConnected();
+  void _onDisconnected();
+  void _onAttempt();
+
+protected:
+  /** Represents a bootstrap server and its statistics. */
+  class Server
+  {
+  public:
+    Server(const QString &host, uint16_t port);
+
+    /** Returns the score of the server, lower is better. */
+    double score() const;
+
+  public:
+    QString host;
+    uint16_t port;
+    /** Resolved addresses. */
+    QList<QHostAddress> addresses;
+    /** Number of answered pings. */
+    size_t successes;
+    /** Number of unanswered pings. */
+    size_t failures;
+    /** Smoothed RTT in ms or -1 if unknown. */
+    double rtt;
+    /** Measures the time since the last ping, invalid if the ping was answered. */
+    QElapsedTimer ping;
+  };
+
+  /** Ranks servers by their score. */
+  static bool _better(const Server *a, const Server *b);
+  /** Resolves the hostname of the given server. */
+  void _resolve(Server *server);
+  /** Pings the given server at all its known addresses. */
+  void _ping(Server *server);
+  /** Returns a pseudo random number in [0,1) for the backoff jitter. */
+  double _jitter();
+
+protected:
+  Node &_dht;
+  BootstrapNodeList &_list;
+  QVector<Server *> _servers;
+  /** Pending DNS lookups. */
+  QHash<int, Server *> _lookups;
+  /** The number of attempts since the last start. */
+  int _attempt;
+  /** Schedules the next attempt. */
+  QTimer _timer;
+  /** State of the jitter RNG. */
+  quint32 _random;
+};
+
+#endif // BOOTSTRAPPER_H
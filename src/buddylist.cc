@@ -10,6 +10,8 @@
 
 // Number of seconds before a node is considered as lost
 #define NODE_LOSS_TIMEOUT 60
+// Number of seconds a node has to respond after a network change
+#define NODE_REVALIDATE_TIMEOUT 5
 
 
 /* ********************************************************************************************* *
@@ -50,6 +52,11 @@ BuddyList::Node::hasBeenSeen() const {
   return _lastSeen.isValid() && (!_addr.isNull());
 }
 
+const QDateTime &
+BuddyList::Node::lastSeen() const {
+  return _lastSeen;
+}
+
 bool
 BuddyList::Node::isOlderThan(size_t seconds) const {
   return (_lastSeen.addSecs(seconds) < QDateTime::currentDateTime());
@@ -69,6 +76,12 @@ BuddyList::Node::invalidate() {
   _port = 0;
 }
 
+void
+BuddyList::Node::expire(size_t seconds) {
+  if (! _lastSeen.isValid()) { return; }
+  _lastSeen = QDateTime::currentDateTime().addSecs(qint64(seconds)-NODE_LOSS_TIMEOUT);
+}
+
 bool
 BuddyList::Node::isReachable() const {
   return hasBeenSeen() && !isOlderThan(NODE_LOSS_TIMEOUT);
@@ -177,7 +190,7 @@ BuddyList::Buddy::addNode(const Identifier &id, const QHostAddress &host, uint16
  * Implementation of BuddyList
  * ********************************************************************************************* */
 BuddyList::BuddyList(Application &application, const QString path, QObject *parent)
-  : QAbstractItemModel(parent), _application(application), _file(path),
+  : QAbstractItemModel(parent), Persistent(), _application(application), _writer(*this, path),
     _presenceTimer(), _searchTimer()
 {
   // Setup timer to update presence of buddy nodes every 10 seconds
@@ -197,14 +210,15 @@ BuddyList::BuddyList(Application &application, const QString path, QObject *pare
           this, SLOT(_onNodeReachable(NodeItem)));
 
   // Read buddy list from file
-  if (! _file.open(QIODevice::ReadOnly)) {
-    logError() << "Can not read buddy list from " << _file.fileName(); return;
+  QFile file(path);
+  if (! file.open(QIODevice::ReadOnly)) {
+    logError() << "Can not read buddy list from " << file.fileName(); return;
   }
-  logDebug() << "Read buddy list from file " << _file.fileName();
+  logDebug() << "Read buddy list from file " << file.fileName();
 
   QJsonParseError err;
-  QJsonDocument doc = QJsonDocument::fromJson(_file.readAll(), &err);
-  _file.close();
+  QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &err);
+  file.close();
   if (! doc.isArray()) {
     logError() << "Malformed buddy list:" << err.offset << err.errorString(); return;
   }
@@ -228,6 +242,8 @@ BuddyList::BuddyList(Application &application, const QString path, QObject *pare
 }
 
 BuddyList::~BuddyList() {
+  // Write pending changes before the buddies get deleted
+  _writer.flush();
   QVector<Buddy *>::iterator item = _buddies.begin();
   for (; item != _buddies.end(); item++) {
     delete *item;
@@ -375,10 +391,11 @@ BuddyList::delNode(const QString &name, const Identifier &node) {
 
 void
 BuddyList::save()  {
-  if (!_file.open(QIODevice::WriteOnly)) {
-    logError() << "Cannot write buddy list!";
-    return;
-  }
+  _writer.schedule();
+}
+
+QByteArray
+BuddyList::persistentData() const {
   // Serialize buddylist
   QJsonDocument doc;
   QJsonArray lst;
@@ -387,10 +404,7 @@ BuddyList::save()  {
     lst.append((*buddy)->toJson());
   }
   doc.setArray(lst);
-  // write to file
-  _file.write(doc.toJson());
-  _file.close();
-  // done.
+  return doc.toJson();
 }
 
 QModelIndex
@@ -491,6 +505,20 @@ BuddyList::_onNodeReachable(const NodeItem &node) {
   emit dataChanged(bidx, nidx);
 }
 
+void
+BuddyList::revalidate() {
+  QHash<Identifier, size_t>::iterator node = _nodes.begin();
+  for (; node != _nodes.end(); node++) {
+    BuddyList::Node *nodeitem = _buddies[node.value()]->node(node.key());
+    if (! nodeitem->hasBeenSeen()) { continue; }
+    nodeitem->expire(NODE_REVALIDATE_TIMEOUT);
+    _application.dht().ping(nodeitem->addr(), nodeitem->port());
+  }
+  // Drop nodes not responding, then search them
+  QTimer::singleShot(1000*(NODE_REVALIDATE_TIMEOUT+1), this, SLOT(_onUpdateNodes()));
+  QTimer::singleShot(1000*(NODE_REVALIDATE_TIMEOUT+2), this, SLOT(_onSearchNodes()));
+}
+
 void
 BuddyList::_onUpdateNodes() {
   QHash<Identifier, size_t>::iterator node = _nodes.begin();
@@ -518,9 +546,15 @@ BuddyList::_onSearchNodes() {
   for (; node != _nodes.end(); node++) {
     BuddyList::Node *nodeitem = _buddies[node.value()]->node(node.key());
     if (! nodeitem->hasBeenSeen()) {
+      // Ping a known address instead of searching, the node appears once it responds
+      QHostAddress addr; uint16_t port;
+      if (_application.addresses().lookup(node.key(), addr, port)) {
+        _application.dht().ping(addr, port);
+        continue;
+      }
       FindNodeQuery *query = new FindNodeQuery(node.key());
       connect(query, SIGNAL(found(NodeItem)), this, SLOT(_onNodeFound(NodeItem)));
-      _application.dht().search(query);
+      _application.lookups().search(query, Metrics::LOOKUP_BUDDIES);
     }
   }
 }
@@ -2,6 +2,7 @@
 #define BUDDYLIST_H
 
 #include <ovlnet/node.hh>
+#include "persistence.hh"
 
 #include <QObject>
 #include <QFile>
@@ -13,7 +14,7 @@ class Application;
 
 
 /** A list of @c Buddy instances being updated regularily. */
-class BuddyList: public QAbstractItemModel
+class BuddyList: public QAbstractItemModel, public Persistent
 {
   Q_OBJECT
 
@@ -42,9 +43,13 @@ public:
     Node(const Identifier &id, const QHostAddress &addr, uint16_t port, Buddy *parent);
 
     bool hasBeenSeen() const;
+    /** Returns the time, the node has been seen last. */
+    const QDateTime &lastSeen() const;
     bool isOlderThan(size_t seconds) const;
     void update(const QHostAddress &addr, uint16_t port);
     void invalidate();
+    /** Marks the node as lost in @c seconds unless it is seen again. */
+    void expire(size_t seconds);
     bool isReachable() const;
 
   protected:
@@ -137,9 +142,15 @@ public:
   int columnCount(const QModelIndex &parent) const;
   QVariant data(const QModelIndex &index, int role) const;
 
+  /** Serializes the buddy list. */
+  QByteArray persistentData() const;
+
 public slots:
-  /** Saves the buddy list. */
+  /** Saves the buddy list. Several modifications within a short time are written at once. */
   void save();
+  /** Pings all nodes at their last known endpoints in one batch. Nodes not responding within
+   * a few seconds are considered lost (e.g., after a change of the network). */
+  void revalidate();
 
 signals:
   void appeared(const Identifier &id);
@@ -153,7 +164,8 @@ protected slots:
 
 protected:
   Application &_application;
-  QFile _file;
+  /** Writes the buddy list file. */
+  DeferredSave _writer;
 
   QVector<Buddy *> _buddies;
   QHash<QString, size_t> _buddyTable;
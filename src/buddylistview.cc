@@ -1,7 +1,6 @@
 #include "buddylistview.hh"
 #include "application.hh"
 #include "searchdialog.hh"
-#include "sockswindow.hh"
 
 #include <QVBoxLayout>
 #include <QToolBar>
@@ -26,8 +25,10 @@ BuddyListView::BuddyListView(Application &application, BuddyList *buddies, QWidg
   QToolBar *box = new QToolBar();
   box->addAction(QIcon("://icons/chat.png"), tr("Chat"), this, SLOT(onChat()));
   box->addAction(QIcon("://icons/phone.png"), tr("Call"), this, SLOT(onCall()));
-  box->addAction(QIcon("://icons/data-transfer-upload.png"), tr("Send file..."),
+  box->addAction(QIcon("://icons/data-transfer-upload.png"), tr("Send files..."),
                  this, SLOT(onSendFile()));
+  box->addAction(QIcon("://icons/data-transfer-upload.png"), tr("Send folder..."),
+                 this, SLOT(onSendDirectory()));
   box->addAction(QIcon("://icons/globe.png"), tr("Start tunnel"), this, SLOT(onStartProxy()));
   box->addSeparator();
   box->addAction(QIcon("://icons/search.png"), tr("Search"), this, SLOT(onSearch()));
@@ -79,15 +80,30 @@ BuddyListView::onCall() {
 
 void
 BuddyListView::onSendFile() {
-  // Get file
-  QString filename = QFileDialog::getOpenFileName(0, tr("Select file"));
-  if (0 == filename.size()) { return; }
-  // check file
-  QFileInfo fileinfo(filename);
-  if (!fileinfo.isReadable()) {
-    QMessageBox::critical(0, tr("Can not open file."),
-                          tr("Can not open file %1").arg(fileinfo.absoluteFilePath()));
+  // Get files, all of them are sent within a single transfer
+  QStringList filenames = QFileDialog::getOpenFileNames(0, tr("Select files"));
+  if (0 == filenames.size()) { return; }
+  // check files
+  foreach (QString filename, filenames) {
+    QFileInfo fileinfo(filename);
+    if (!fileinfo.isReadable()) {
+      QMessageBox::critical(0, tr("Can not open file."),
+                            tr("Can not open file %1").arg(fileinfo.absoluteFilePath()));
+      return;
+    }
   }
+  _sendFiles(filenames);
+}
+
+void
+BuddyListView::onSendDirectory() {
+  QString dirname = QFileDialog::getExistingDirectory(0, tr("Select folder"));
+  if (0 == dirname.size()) { return; }
+  _sendFiles(QStringList() << dirname);
+}
+
+void
+BuddyListView::_sendFiles(const QStringList &paths) {
   // Get selected items
   QModelIndexList items = _tree->selectionModel()->selectedIndexes();
   if (0 == items.size()) { return; }
@@ -95,13 +111,11 @@ BuddyListView::onSendFile() {
 
   if (_application.buddies().isBuddy(items.first())) {
     if (0 == _application.buddies().getBuddy(items.first())->numNodes()) { return; }
-    _application.sendFile(
-          fileinfo.absoluteFilePath(), fileinfo.size(),
-          _application.buddies().getBuddy(items.first())->node(0)->id());
+    _application.sendFiles(
+          paths, _application.buddies().getBuddy(items.first())->node(0)->id());
   } else if (_application.buddies().isNode(items.first())) {
-    _application.sendFile(
-          fileinfo.absoluteFilePath(), fileinfo.size(),
-          _application.buddies().getNode(items.first())->id());
+    _application.sendFiles(
+          paths, _application.buddies().getNode(items.first())->id());
   }
 }
 
@@ -120,7 +134,7 @@ BuddyListView::onStartProxy() {
     node = _application.buddies().getNode(items.first());
   }
   if (node->hasBeenSeen()) {
-    (new SocksWindow(_application, *node))->show();
+    _application.startProxy(*node);
   } else {
     QMessageBox::critical(0, tr("Cannot start proxy service."),
                           tr("Node %1 is not reachable.").arg(QString(node->id().toHex())));
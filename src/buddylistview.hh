@@ -18,12 +18,15 @@ protected slots:
   void onChat();
   void onCall();
   void onSendFile();
+  void onSendDirectory();
   void onStartProxy();
   void onSearch();
   void onDelete();
 
 protected:
   void closeEvent(QCloseEvent *evt);
+  /** Sends the given files to the selected buddy or node. */
+  void _sendFiles(const QStringList &paths);
 
 protected:
   Application &_application;
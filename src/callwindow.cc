@@ -42,9 +42,12 @@ CallWindow::CallWindow(Application &application, SecureCall *call, QWidget *pare
 
   QObject::connect(_call, SIGNAL(started()), this, SLOT(onCallStarted()));
   QObject::connect(_call, SIGNAL(ended()), this, SLOT(onCallEnd()));
+
+  _application.metrics().streamOpened(Metrics::CALL);
 }
 
 CallWindow::~CallWindow() {
+  _application.metrics().streamClosed(Metrics::CALL);
   _call->deleteLater();
 }
 
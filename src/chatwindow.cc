@@ -30,9 +30,12 @@ ChatWindow::ChatWindow(Application &app, SecureChat *chat, QWidget *parent)
   connect(_chat, SIGNAL(messageReceived(QString)), this, SLOT(_onMessageReceived(QString)));
   connect(_chat, SIGNAL(closed()), this, SLOT(_onConnectionLost()));
   connect(_text, SIGNAL(returnPressed()), this, SLOT(_onMessageSend()));
+
+  _application.metrics().streamOpened(Metrics::CHAT);
 }
 
 ChatWindow::~ChatWindow() {
+  _application.metrics().streamClosed(Metrics::CHAT);
   _chat->deleteLater();
 }
 
@@ -3,46 +3,187 @@
 #include <QPen>
 #include <QBrush>
 #include <QColor>
+#include <QMouseEvent>
+#include <QToolTip>
+#include <algorithm>
+#include <cmath>
+
+// Margin of the graph in pixels
+#define NETGRAPH_MARGIN  10
+// Radius of a node in pixels
+#define NETGRAPH_RADIUS  5
+// Minimum number of pixels per node, below the density is shown
+#define NETGRAPH_MIN_SPACING 4
+// Width of a histogram bin in pixels
+#define NETGRAPH_BIN_WIDTH 2
+
+
+/* Orders node indices by the distance of the nodes. */
+class DistanceOrder
+{
+public:
+  DistanceOrder(const NeighborList &nodes) : _nodes(nodes) { }
+  bool operator()(int a, int b) const { return _nodes[a].distance < _nodes[b].distance; }
+  bool operator()(int a, double b) const { return _nodes[a].distance < b; }
+protected:
+  const NeighborList &_nodes;
+};
+
 
 DHTNetGraph::DHTNetGraph(QWidget *parent)
-  : QWidget(parent)
+  : QWidget(parent), _nodes(), _sorted(), _cache(), _dirty(true), _dense(false), _hover(-1)
 {
   setMinimumWidth(300);
   setMinimumHeight(75);
+  setMouseTracking(true);
 
-  update(QList< QPair<double, bool> >());
+  update(NeighborList());
 }
 
 void
-DHTNetGraph::update(const QList<QPair<double, bool> > &nodes) {
+DHTNetGraph::update(const NeighborList &nodes) {
   _nodes = nodes;
+  // Update spatial index
+  _sorted.resize(_nodes.size());
+  for (int i=0; i<_nodes.size(); i++) { _sorted[i] = i; }
+  std::sort(_sorted.begin(), _sorted.end(), DistanceOrder(_nodes));
+  _hover = -1;
+  _dirty = true;
   QWidget::update();
 }
 
 void
 DHTNetGraph::paintEvent(QPaintEvent *evt) {
+  if (_dirty || (_cache.size() != size())) { _render(); }
   QPainter painter(this);
+  painter.drawPixmap(0, 0, _cache);
+
+  // Highlight node under the cursor
+  if ((_hover >= 0) && (! _dense)) {
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(QPen(Qt::red, 2));
+    painter.setBrush(Qt::NoBrush);
+    painter.drawEllipse(QPoint(_x(_nodes[_hover].distance), height()/2),
+                        NETGRAPH_RADIUS+2, NETGRAPH_RADIUS+2);
+  }
+}
+
+void
+DHTNetGraph::resizeEvent(QResizeEvent *evt) {
+  _dirty = true;
+  QWidget::resizeEvent(evt);
+}
+
+void
+DHTNetGraph::mouseMoveEvent(QMouseEvent *evt) {
+  int hover = _nodeAt(evt->pos().x());
+  if (hover != _hover) {
+    _hover = hover;
+    QWidget::update();
+  }
+  if (_hover < 0) {
+    QToolTip::hideText();
+    return;
+  }
+  const Neighbor &node = _nodes[_hover];
+  QString text = tr("%1\nBucket %2").arg(node.id.toBase32()).arg(node.bucket);
+  if (node.buddy) { text += tr(" (contact)"); }
+  if (_dense) {
+    // Count nodes within the bin under the cursor
+    double w = width()-2*NETGRAPH_MARGIN;
+    double from = double(evt->pos().x()-NETGRAPH_MARGIN-NETGRAPH_BIN_WIDTH)/w;
+    double to = double(evt->pos().x()-NETGRAPH_MARGIN+NETGRAPH_BIN_WIDTH)/w;
+    DistanceOrder order(_nodes);
+    int n = std::lower_bound(_sorted.begin(), _sorted.end(), to, order) -
+        std::lower_bound(_sorted.begin(), _sorted.end(), from, order);
+    text += tr("\n%1 nodes nearby").arg(n);
+  }
+  QToolTip::showText(evt->globalPos(), text, this);
+}
+
+void
+DHTNetGraph::leaveEvent(QEvent *evt) {
+  _hover = -1;
+  QToolTip::hideText();
+  QWidget::update();
+  QWidget::leaveEvent(evt);
+}
+
+int
+DHTNetGraph::_x(double distance) const {
+  return NETGRAPH_MARGIN + (width()-2*NETGRAPH_MARGIN)*distance;
+}
+
+int
+DHTNetGraph::_nodeAt(int x) const {
+  if (_sorted.isEmpty()) { return -1; }
+  double w = width()-2*NETGRAPH_MARGIN;
+  if (w <= 0) { return -1; }
+  // Find the closest node by binary search
+  double distance = double(x-NETGRAPH_MARGIN)/w;
+  QVector<int>::const_iterator it = std::lower_bound(
+        _sorted.begin(), _sorted.end(), distance, DistanceOrder(_nodes));
+  int best = -1; int bestDx = NETGRAPH_RADIUS+1;
+  if (it != _sorted.end()) {
+    int dx = std::abs(_x(_nodes[*it].distance) - x);
+    if (dx < bestDx) { best = *it; bestDx = dx; }
+  }
+  if (it != _sorted.begin()) {
+    int dx = std::abs(_x(_nodes[*(it-1)].distance) - x);
+    if (dx < bestDx) { best = *(it-1); bestDx = dx; }
+  }
+  return best;
+}
+
+void
+DHTNetGraph::_render() {
+  _cache = QPixmap(size());
+  _dirty = false;
+
+  QPainter painter(&_cache);
   painter.setRenderHint(QPainter::Antialiasing);
   painter.fillRect(rect(), "white");
 
-  int margin = 10;
+  int margin = NETGRAPH_MARGIN;
+  int w = width()-2*margin;
 
   // Draw axis
   painter.setPen(QPen(Qt::black, 3));
   painter.drawLine(margin, height()/2, width()-2*margin, height()/2);
   painter.setBrush(QBrush(Qt::black));
-  painter.drawEllipse(QPoint(margin,height()/2), 5,5);
+  painter.drawEllipse(QPoint(margin,height()/2), NETGRAPH_RADIUS, NETGRAPH_RADIUS);
+
+  _dense = (w > 0) && (_nodes.size()*NETGRAPH_MIN_SPACING > w);
+  if (_dense) {
+    // Draw a histogram of the node density (log scale), cost is independent of the number of
+    // nodes once binned.
+    QVector<int> bins(w/NETGRAPH_BIN_WIDTH+1, 0);
+    NeighborList::const_iterator item = _nodes.begin();
+    for (; item != _nodes.end(); item++) {
+      bins[std::min(int(item->distance*w)/NETGRAPH_BIN_WIDTH, bins.size()-1)]++;
+    }
+    int maxCount = *std::max_element(bins.begin(), bins.end());
+    double scale = (height()/2-2)/std::log(1.0+maxCount);
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(QBrush(Qt::gray));
+    for (int i=0; i<bins.size(); i++) {
+      if (0 == bins[i]) { continue; }
+      int h = std::max(1, int(scale*std::log(1.0+bins[i])));
+      painter.drawRect(margin+i*NETGRAPH_BIN_WIDTH, height()/2-h, NETGRAPH_BIN_WIDTH, 2*h);
+    }
+  }
 
-  // Draw nodes
+  // Draw nodes (buddies only if dense)
   painter.setPen(QPen(Qt::black, 2));
-  QList< QPair<double, bool> >::iterator item = _nodes.begin();
+  NeighborList::const_iterator item = _nodes.begin();
   for (; item != _nodes.end(); item++) {
-    if (item->second) {
+    if (item->buddy) {
       painter.setBrush(QBrush(Qt::blue));
+    } else if (_dense) {
+      continue;
     } else {
       painter.setBrush(QBrush(Qt::gray));
     }
-    int x = margin+(width()-2*margin)*item->first;
-    painter.drawEllipse(QPoint(x,height()/2), 5,5);
+    painter.drawEllipse(QPoint(_x(item->distance),height()/2), NETGRAPH_RADIUS, NETGRAPH_RADIUS);
   }
 }
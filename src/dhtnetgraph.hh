@@ -2,22 +2,48 @@
 #define DHTNETGRAPH_H
 
 #include <QWidget>
+#include <QPixmap>
+#include <QVector>
 #include <ovlnet/node.hh>
+#include "dhtstatus.hh"
 
 
+/** Shows the neighbors of the node along the (logarithmic) distance axis. The graph is rendered
+ * into a cached pixmap whenever the neighborhood or the size changes, hence painting is cheap.
+ * If there are too many nodes to be shown individually, their density is shown instead. */
 class DHTNetGraph : public QWidget
 {
   Q_OBJECT
 public:
   explicit DHTNetGraph(QWidget *parent = 0);
 
-  void update(const QList< QPair<double, bool> > &nodes);
+  void update(const NeighborList &nodes);
 
 protected:
   virtual void paintEvent(QPaintEvent *evt);
+  virtual void resizeEvent(QResizeEvent *evt);
+  virtual void mouseMoveEvent(QMouseEvent *evt);
+  virtual void leaveEvent(QEvent *evt);
+
+  /** Renders the graph into the cache. */
+  void _render();
+  /** Returns the x coordinate of the given distance. */
+  int _x(double distance) const;
+  /** Returns the index of the node closest to the given x coordinate or -1. */
+  int _nodeAt(int x) const;
 
 protected:
-  QList< QPair<double, bool> > _nodes;
+  NeighborList _nodes;
+  /** Indices of the nodes sorted by their distance. */
+  QVector<int> _sorted;
+  /** The rendered graph. */
+  QPixmap _cache;
+  /** If @c true, the cache needs to be rendered again. */
+  bool _dirty;
+  /** If @c true, the density is shown instead of the individual nodes. */
+  bool _dense;
+  /** The node under the mouse cursor or -1. */
+  int _hover;
 };
 
 #endif // DHTNETGRAPH_H
@@ -2,13 +2,42 @@
 #include <ovlnet/dht_config.hh>
 #include "application.hh"
 
+#include <QSet>
+#include <QDateTime>
 #include <cmath>
 
+// Interval (ms) to remove nodes that left the routing table
+#define DHTSTATUS_RECONCILE_INTERVAL (1000*30)
+// Time span (ms) of the bucket history
+#define DHTSTATUS_HISTORY_SPAN (1000*60*10)
+
+// Capacity of a k-bucket
+#ifndef OVL_K
+#define OVL_K 8
+#endif
+
 
 DHTStatus::DHTStatus(Application &app, QObject *parent)
-  : QObject(parent), _application(app)
+  : QObject(parent), _application(app), _neighbors(), _revision(0), _cachedRevision(-1),
+    _cached(), _buckets(), _bucketHistory(), _reconcileTimer()
 {
-  // pass...
+  BucketStats empty; empty.nodes = 0; empty.addedSum = 0; empty.joined = 0; empty.left = 0;
+  _buckets.fill(empty, 8*OVL_HASH_SIZE+1);
+
+  _reconcileTimer.setInterval(DHTSTATUS_RECONCILE_INTERVAL);
+  _reconcileTimer.setSingleShot(false);
+  connect(&_reconcileTimer, SIGNAL(timeout()), this, SLOT(_onReconcile()));
+
+  connect(&_application.dht(), SIGNAL(nodeReachable(NodeItem)),
+          this, SLOT(_onNodeReachable(NodeItem)));
+  connect(&_application.buddies(), SIGNAL(rowsInserted(QModelIndex,int,int)),
+          this, SLOT(_onBuddiesChanged()));
+  connect(&_application.buddies(), SIGNAL(rowsRemoved(QModelIndex,int,int)),
+          this, SLOT(_onBuddiesChanged()));
+  connect(&_application.buddies(), SIGNAL(modelReset()), this, SLOT(_onBuddiesChanged()));
+
+  _onReconcile();
+  _reconcileTimer.start();
 }
 
 QString
@@ -46,17 +75,109 @@ DHTStatus::outRate() const {
   return _application.dht().outRate();
 }
 
+NeighborList
+DHTStatus::neighbors() const {
+  if (_cachedRevision != _revision) {
+    _cached.clear();
+    _cached.reserve(_neighbors.size());
+    QHash<Identifier, Neighbor>::const_iterator item = _neighbors.begin();
+    for (; item != _neighbors.end(); item++) {
+      _cached.append(item.value());
+    }
+    _cachedRevision = _revision;
+  }
+  return _cached;
+}
+
+size_t
+DHTStatus::revision() const {
+  return _revision;
+}
+
+const QVector<BucketStats> &
+DHTStatus::buckets() const {
+  return _buckets;
+}
+
+const QList<BucketSample> &
+DHTStatus::bucketHistory() const {
+  return _bucketHistory;
+}
+
+void
+DHTStatus::_add(const Identifier &id) {
+  if (_neighbors.contains(id) || (id == _application.dht().id())) { return; }
+  // Compute log distance to self once
+  Distance d = _application.dht().id() - id;
+  Neighbor neighbor;
+  neighbor.id = id;
+  neighbor.bucket = d.leadingBit();
+  neighbor.distance = double(neighbor.bucket)/(8*OVL_HASH_SIZE);
+  neighbor.buddy = _application.buddies().hasNode(id);
+  neighbor.added = QDateTime::currentMSecsSinceEpoch();
+  _neighbors.insert(id, neighbor);
+  _revision++;
+  // Update bucket statistics
+  BucketStats &bucket = _buckets[neighbor.bucket];
+  bucket.nodes++; bucket.joined++;
+  bucket.addedSum += neighbor.added;
+}
+
 void
-DHTStatus::neighbors(QList<QPair<double, bool> > &nodes) const {
-  // Collect all nodes
+DHTStatus::_removed(const Neighbor &neighbor) {
+  BucketStats &bucket = _buckets[neighbor.bucket];
+  bucket.nodes--; bucket.left++;
+  bucket.addedSum -= neighbor.added;
+}
+
+void
+DHTStatus::_onNodeReachable(const NodeItem &node) {
+  // The routing table takes a reachable node if its bucket has room. Nodes missed or added
+  // wrongly (e.g. if the bucket filled up meanwhile) are fixed by the next reconcile.
+  if (_neighbors.contains(node.id()) || (node.id() == _application.dht().id())) { return; }
+  Distance d = _application.dht().id() - node.id();
+  if (_buckets[d.leadingBit()].nodes < OVL_K) {
+    _add(node.id());
+  }
+}
+
+void
+DHTStatus::_onBuddiesChanged() {
+  QHash<Identifier, Neighbor>::iterator item = _neighbors.begin();
+  for (; item != _neighbors.end(); item++) {
+    item->buddy = _application.buddies().hasNode(item.key());
+  }
+  _revision++;
+}
+
+void
+DHTStatus::_onReconcile() {
+  _sync();
+  // Sample statistics, kept even if no window shows them
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+  BucketSample sample; sample.time = now; sample.buckets = _buckets;
+  _bucketHistory.append(sample);
+  while ((_bucketHistory.size() > 2) &&
+         ((now - _bucketHistory.first().time) > DHTSTATUS_HISTORY_SPAN)) {
+    _bucketHistory.removeFirst();
+  }
+}
+
+void
+DHTStatus::_sync() {
+  // Sync with the routing table (removes nodes that left it)
   QList<NodeItem> nodeitems; _application.dht().nodes(nodeitems);
+  QSet<Identifier> ids;
   QList<NodeItem>::iterator item = nodeitems.begin();
   for (; item != nodeitems.end(); item++) {
-    // Compute log distance to self
-    Distance d = _application.dht().id() - item->id();
-    nodes.push_back(
-          QPair<double, bool>(
-            double(d.leadingBit())/(8*OVL_HASH_SIZE),
-            _application.buddies().hasNode(item->id())));
+    ids.insert(item->id());
+    _add(item->id());
+  }
+  QHash<Identifier, Neighbor>::iterator neighbor = _neighbors.begin();
+  while (neighbor != _neighbors.end()) {
+    if (ids.contains(neighbor.key())) { neighbor++; continue; }
+    _removed(neighbor.value());
+    neighbor = _neighbors.erase(neighbor);
+    _revision++;
   }
 }
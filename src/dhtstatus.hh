@@ -3,12 +3,57 @@
 
 #include <QObject>
 #include <QList>
+#include <QHash>
+#include <QVector>
+#include <QTimer>
 #include <ovlnet/node.hh>
 
 // forward declarations
 class Application;
 
-/** Simple object to collect and compute some information about the status of the DHT node. */
+
+/** A neighbor of the DHT node. */
+typedef struct {
+  /** The identifier of the node. */
+  Identifier id;
+  /** Distance to the node on a logarithmic scale (0,1]. */
+  double distance;
+  /** The index of the bucket, the node belongs to. */
+  int bucket;
+  /** If @c true, the node belongs to a buddy. */
+  bool buddy;
+  /** Time (ms since epoch), the node was added to the neighborhood. */
+  qint64 added;
+} Neighbor;
+
+/** An immutable (implicitly shared) list of neighbors. */
+typedef QVector<Neighbor> NeighborList;
+
+/** Statistics of a single k-bucket. The nodes joining and leaving are counted by comparing
+ * the routing table between syncs, hence a node evicted and re-added in between is missed. */
+typedef struct {
+  /** Number of nodes in the bucket. */
+  size_t nodes;
+  /** Sum of the times (ms since epoch) the nodes were added, gives the average age. */
+  qint64 addedSum;
+  /** Total number of nodes seen joining the bucket. */
+  size_t joined;
+  /** Total number of nodes seen leaving the bucket. */
+  size_t left;
+} BucketStats;
+
+/** The statistics of all buckets at a certain time. */
+typedef struct {
+  /** Time of the sample (ms since epoch). */
+  qint64 time;
+  /** The bucket statistics at that time. */
+  QVector<BucketStats> buckets;
+} BucketSample;
+
+
+/** Simple object to collect and compute some information about the status of the DHT node.
+ * Reachable nodes join the neighborhood if their bucket has room, the neighborhood is synced
+ * with the routing table periodically, hence querying it is cheap. */
 class DHTStatus : public QObject
 {
   Q_OBJECT
@@ -30,12 +75,48 @@ public:
   double inRate() const;
   double outRate() const;
 
-  /** Stores the neighbors of DHT node into the list with their distance on a logarithmic
-   * scale (0,1]. */
-  void neighbors(QList< QPair<double, bool> > &nodes) const;
+  /** Returns the neighbors of DHT node with their distance on a logarithmic scale (0,1].
+   * The list is only rebuilt if the neighborhood changed since the last call. */
+  NeighborList neighbors() const;
+  /** Returns a number that changes whenever the neighborhood changes. */
+  size_t revision() const;
+  /** Returns the statistics of all buckets, indexed by the bucket. These are maintained with
+   * every change of the neighborhood. */
+  const QVector<BucketStats> &buckets() const;
+  /** Returns the samples of the bucket statistics of the last minutes (oldest first), to
+   * compute the rates of nodes joining and leaving. */
+  const QList<BucketSample> &bucketHistory() const;
+
+protected slots:
+  void _onNodeReachable(const NodeItem &node);
+  void _onBuddiesChanged();
+  /** Syncs with the routing table and samples the bucket statistics. */
+  void _onReconcile();
+
+protected:
+  /** Syncs the neighborhood with the routing table. */
+  void _sync();
+  /** Adds a node to the neighborhood if it is not known yet. */
+  void _add(const Identifier &id);
+  /** Updates the bucket statistics for a removed node. */
+  void _removed(const Neighbor &neighbor);
 
 protected:
   Application &_application;
+  /** The current neighborhood. */
+  QHash<Identifier, Neighbor> _neighbors;
+  /** Incremented on every change of the neighborhood. */
+  size_t _revision;
+  /** The revision of the cached list. */
+  mutable size_t _cachedRevision;
+  /** The cached list of neighbors. */
+  mutable NeighborList _cached;
+  /** Statistics per bucket. */
+  QVector<BucketStats> _buckets;
+  /** Samples of the bucket statistics. */
+  QList<BucketSample> _bucketHistory;
+  /** Timer to remove nodes that left the routing table. */
+  QTimer _reconcileTimer;
 };
 
 #endif // DHTSTATUS_H
@@ -7,9 +7,19 @@
 #include <QHBoxLayout>
 #include <QCloseEvent>
 #include <QTabWidget>
+#include <QGridLayout>
+#include <QHeaderView>
+#include <QBrush>
+#include <QDateTime>
+#include <ovlnet/dht_config.hh>
 
 #include "application.hh"
 
+// Capacity of a k-bucket
+#ifndef OVL_K
+#define OVL_K 8
+#endif
+
 
 /* ******************************************************************************************** *
  * Implementation of DHTStatusWindow
@@ -21,6 +31,9 @@ DHTStatusWindow::DHTStatusWindow(Application &app, QWidget *parent)
 
   QTabWidget *tabs = new QTabWidget();
   tabs->addTab(new DHTStatusView(app), QIcon("://icons/dashboard.png"), tr("Status"));
+  tabs->addTab(new DHTHistoryView(app), QIcon("://icons/dashboard.png"), tr("History"));
+  tabs->addTab(new DHTLookupView(app), QIcon("://icons/search.png"), tr("Lookups"));
+  tabs->addTab(new DHTBucketView(app), QIcon("://icons/fork.png"), tr("Buckets"));
   tabs->addTab(new LogWidget(app), QIcon("://icons/list.png"), tr("Log"));
 
   QVBoxLayout *layout = new QVBoxLayout();
@@ -39,14 +52,14 @@ DHTStatusWindow::closeEvent(QCloseEvent *evt) {
  * Implementation of DHTStatusView
  * ******************************************************************************************** */
 DHTStatusView::DHTStatusView(Application &app, QWidget *parent) :
-  QWidget(parent), _status(&app.status()), _updateTimer()
+  QWidget(parent), _status(&app.status()), _metrics(app.metrics()), _revision(0), _updateTimer()
 {
   _updateTimer.setInterval(5000);
   _updateTimer.setSingleShot(false);
 
   _numPeers = new QLabel(QString::number(_status->numNeighbors()));
   _numStreams = new QLabel(QString::number(_status->numStreams()));
-
+  _loopDelay = new QLabel(tr("-"));
 
   _bytesReceived = new QLabel(_formatBytes(_status->bytesReceived()));
   _bytesSend = new QLabel(_formatBytes(_status->bytesSend()));
@@ -54,8 +67,8 @@ DHTStatusView::DHTStatusView(Application &app, QWidget *parent) :
   _outRate = new QLabel(_formatRate(_status->outRate()));
 
   _dhtNet   = new DHTNetGraph();
-  QList<QPair<double, bool> > nodes; _status->neighbors(nodes);
-  _dhtNet->update(nodes);
+  _dhtNet->update(_status->neighbors());
+  _revision = _status->revision();
 
   QVBoxLayout *layout= new QVBoxLayout();
   layout->addWidget(new QLabel(tr("Identifier: <b>%1</b>").arg(_status->identifier())));
@@ -63,6 +76,7 @@ DHTStatusView::DHTStatusView(Application &app, QWidget *parent) :
   QFormLayout *form = new QFormLayout();
   form->addRow(tr("Peers:"), _numPeers);
   form->addRow(tr("Active streams:"), _numStreams);
+  form->addRow(tr("Event delay (99%/max):"), _loopDelay);
   row->addLayout(form);
   form = new QFormLayout();
   form->addRow(tr("Received:"), _bytesReceived);
@@ -83,12 +97,17 @@ void
 DHTStatusView::_onUpdate() {
   _numPeers->setText(QString::number(_status->numNeighbors()));
   _numStreams->setText(QString::number(_status->numStreams()));
+  const LatencyHistogram &delays = _metrics.eventLoopDelays();
+  _loopDelay->setText(tr("%1ms / %2ms").arg(delays.quantile(0.99)).arg(delays.quantile(1.0)));
   _bytesReceived->setText(_formatBytes(_status->bytesReceived()));
   _bytesSend->setText(_formatBytes(_status->bytesSend()));
   _inRate->setText(_formatRate(_status->inRate()));
   _outRate->setText(_formatRate(_status->outRate()));
-  QList<QPair<double, bool> > nodes; _status->neighbors(nodes);
-  _dhtNet->update(nodes);
+  // Redraw graph only if the neighborhood changed
+  if (_revision != _status->revision()) {
+    _dhtNet->update(_status->neighbors());
+    _revision = _status->revision();
+  }
 }
 
 QString
@@ -114,3 +133,181 @@ DHTStatusView::_formatRate(double rate) {
   return QString("%1Mb/s").arg(QString::number(rate/1e6, 'f', 1));
 }
 
+
+
+/* ******************************************************************************************** *
+ * Implementation of DHTHistoryView
+ * ******************************************************************************************** */
+DHTHistoryView::DHTHistoryView(Application &app, QWidget *parent)
+  : QWidget(parent), _history(app.history()), _updateTimer()
+{
+  _updateTimer.setInterval(1000);
+  _updateTimer.setSingleShot(false);
+
+  _level = new QComboBox();
+  _level->addItem(tr("Last hour"), int(TimeSeries::SECONDS));
+  _level->addItem(tr("Last day"), int(TimeSeries::MINUTES));
+  _level->addItem(tr("Last month"), int(TimeSeries::HOURS));
+
+  QGridLayout *grid = new QGridLayout();
+  for (int i=0; i<MetricsHistory::NUM_SERIES; i++) {
+    _lines[i] = new Sparkline();
+    _labels[i] = new QLabel();
+    grid->addWidget(new QLabel(MetricsHistory::name(MetricsHistory::Series(i))), i, 0);
+    grid->addWidget(_lines[i], i, 1);
+    grid->addWidget(_labels[i], i, 2);
+  }
+  grid->setColumnStretch(1, 1);
+
+  QVBoxLayout *layout = new QVBoxLayout();
+  layout->addWidget(_level);
+  layout->addLayout(grid);
+  setLayout(layout);
+
+  connect(_level, SIGNAL(currentIndexChanged(int)), this, SLOT(_onUpdate()));
+  connect(&_updateTimer, SIGNAL(timeout()), this, SLOT(_onUpdate()));
+  _updateTimer.start();
+  _onUpdate();
+}
+
+void
+DHTHistoryView::_onUpdate() {
+  // Skip updates while the tab is hidden
+  if (! isVisible()) { return; }
+  TimeSeries::Level level = TimeSeries::Level(_level->currentData().toInt());
+  for (int i=0; i<MetricsHistory::NUM_SERIES; i++) {
+    MetricsHistory::Series series = MetricsHistory::Series(i);
+    _lines[i]->update(_history.series(series).buckets(level));
+    _labels[i]->setText(tr("avg %1, max %2")
+                        .arg(QString::number(_lines[i]->average(), 'g', 3))
+                        .arg(QString::number(_lines[i]->maximum(), 'g', 3)));
+  }
+}
+
+
+/* ******************************************************************************************** *
+ * Implementation of DHTLookupView
+ * ******************************************************************************************** */
+DHTLookupView::DHTLookupView(Application &app, QWidget *parent)
+  : QWidget(parent), _metrics(app.metrics()), _updateTimer()
+{
+  _updateTimer.setInterval(2000);
+  _updateTimer.setSingleShot(false);
+
+  _table = new QTableWidget(Metrics::NUM_LOOKUPS, 6);
+  QStringList headers;
+  headers << tr("Found") << tr("Failed") << tr("Median") << tr("90%") << tr("99%")
+          << tr("Failed median");
+  _table->setHorizontalHeaderLabels(headers);
+  QStringList origins;
+  origins << tr("Search") << tr("Contacts") << tr("Chat") << tr("Call") << tr("File");
+  _table->setVerticalHeaderLabels(origins);
+  _table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  _table->horizontalHeader()->setStretchLastSection(true);
+
+  _cache = new QLabel();
+
+  QVBoxLayout *layout = new QVBoxLayout();
+  layout->addWidget(_table);
+  layout->addWidget(_cache);
+  setLayout(layout);
+
+  connect(&_updateTimer, SIGNAL(timeout()), this, SLOT(_onUpdate()));
+  _updateTimer.start();
+  _onUpdate();
+}
+
+void
+DHTLookupView::_onUpdate() {
+  if (! isVisible()) { return; }
+  for (int i=0; i<Metrics::NUM_LOOKUPS; i++) {
+    const LatencyHistogram &found = _metrics.lookups(Metrics::Lookup(i), true);
+    const LatencyHistogram &failed = _metrics.lookups(Metrics::Lookup(i), false);
+    QStringList cells;
+    cells << QString::number(found.count()) << QString::number(failed.count());
+    if (found.count()) {
+      cells << tr("%1ms").arg(found.quantile(0.5)) << tr("%1ms").arg(found.quantile(0.9))
+            << tr("%1ms").arg(found.quantile(0.99));
+    } else {
+      cells << "-" << "-" << "-";
+    }
+    cells << (failed.count() ? tr("%1ms").arg(failed.quantile(0.5)) : QString("-"));
+    for (int j=0; j<cells.size(); j++) {
+      _table->setItem(i, j, new QTableWidgetItem(cells[j]));
+    }
+  }
+  _cache->setText(tr("Address cache: %1 hits, %2 misses (lookups avoided)")
+                  .arg(_metrics.count(Metrics::ADDRESS_CACHE_HITS))
+                  .arg(_metrics.count(Metrics::ADDRESS_CACHE_MISSES)));
+}
+
+
+/* ******************************************************************************************** *
+ * Implementation of DHTBucketView
+ * ******************************************************************************************** */
+DHTBucketView::DHTBucketView(Application &app, QWidget *parent)
+  : QWidget(parent), _status(&app.status()), _updateTimer()
+{
+  _updateTimer.setInterval(5000);
+  _updateTimer.setSingleShot(false);
+
+  _table = new QTableWidget(0, 5);
+  QStringList headers;
+  headers << tr("Bucket") << tr("Fill") << tr("Avg. age") << tr("Joined/h") << tr("Left/h");
+  _table->setHorizontalHeaderLabels(headers);
+  _table->verticalHeader()->setVisible(false);
+  _table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  _table->horizontalHeader()->setStretchLastSection(true);
+
+  _info = new QLabel();
+  _info->setWordWrap(true);
+
+  QVBoxLayout *layout = new QVBoxLayout();
+  layout->addWidget(_info);
+  layout->addWidget(_table);
+  setLayout(layout);
+
+  connect(&_updateTimer, SIGNAL(timeout()), this, SLOT(_onUpdate()));
+  _updateTimer.start();
+  _onUpdate();
+}
+
+void
+DHTBucketView::_onUpdate() {
+  if (! isVisible()) { return; }
+  // The history is kept by DHTStatus, it is never empty
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+  const QVector<BucketStats> &buckets = _status->buckets();
+  const BucketSample &oldest = _status->bucketHistory().first();
+  double hours = double(now - oldest.time)/(1000*60*60);
+  _info->setText(tr("Nodes joining and leaving the routing table per hour over the last %1 "
+                    "minutes, as observed by comparing the routing table periodically.")
+                 .arg((now - oldest.time)/60000));
+  _table->setRowCount(0);
+  for (int i=0; i<buckets.size(); i++) {
+    const BucketStats &bucket = buckets[i];
+    size_t joined = bucket.joined - oldest.buckets[i].joined;
+    size_t left = bucket.left - oldest.buckets[i].left;
+    if ((0 == bucket.nodes) && (0 == joined) && (0 == left)) { continue; }
+
+    int row = _table->rowCount();
+    _table->setRowCount(row+1);
+    _table->setItem(row, 0, new QTableWidgetItem(QString::number(i)));
+    QTableWidgetItem *fill = new QTableWidgetItem(tr("%1 / %2").arg(bucket.nodes).arg(OVL_K));
+    if (bucket.nodes >= OVL_K) { fill->setForeground(QBrush(Qt::darkGreen)); }
+    _table->setItem(row, 1, fill);
+    QString age = "-";
+    if (bucket.nodes) {
+      qint64 avg = (now - bucket.addedSum/qint64(bucket.nodes))/1000;
+      age = (avg < 120) ? tr("%1s").arg(avg) : tr("%1min").arg(avg/60);
+    }
+    _table->setItem(row, 2, new QTableWidgetItem(age));
+    QString joinRate = "-", leaveRate = "-";
+    if (hours > 0) {
+      joinRate = QString::number(joined/hours, 'f', 1);
+      leaveRate = QString::number(left/hours, 'f', 1);
+    }
+    _table->setItem(row, 3, new QTableWidgetItem(joinRate));
+    _table->setItem(row, 4, new QTableWidgetItem(leaveRate));
+  }
+}
@@ -3,9 +3,14 @@
 
 #include "dhtstatus.hh"
 #include "dhtnetgraph.hh"
+#include "history.hh"
+#include "metrics.hh"
+#include "sparkline.hh"
 #include <QWidget>
 #include <QTimer>
 #include <QLabel>
+#include <QComboBox>
+#include <QTableWidget>
 
 
 class DHTStatusWindow: public QWidget
@@ -37,9 +42,14 @@ protected:
 
 protected:
   DHTStatus *_status;
+  /** The client metrics (event loop delays). */
+  Metrics &_metrics;
+  /** The revision of the neighborhood shown. */
+  size_t _revision;
 
   QLabel *_numPeers;
   QLabel *_numStreams;
+  QLabel *_loopDelay;
   QLabel *_bytesReceived;
   QLabel *_bytesSend;
   QLabel *_inRate;
@@ -50,4 +60,74 @@ protected:
   QTimer _updateTimer;
 };
 
+
+/** Shows the history of the traffic, peers and streams as sparklines. */
+class DHTHistoryView : public QWidget
+{
+  Q_OBJECT
+
+public:
+  explicit DHTHistoryView(Application &app, QWidget *parent = 0);
+
+protected slots:
+  void _onUpdate();
+
+protected:
+  /** The recorded history. */
+  MetricsHistory &_history;
+  /** Selects the resolution shown. */
+  QComboBox *_level;
+  /** One sparkline for each series. */
+  Sparkline *_lines[MetricsHistory::NUM_SERIES];
+  /** Average and maximum of each series. */
+  QLabel *_labels[MetricsHistory::NUM_SERIES];
+
+  QTimer _updateTimer;
+};
+
+
+/** Shows the latency of node lookups per origin. */
+class DHTLookupView : public QWidget
+{
+  Q_OBJECT
+
+public:
+  explicit DHTLookupView(Application &app, QWidget *parent = 0);
+
+protected slots:
+  void _onUpdate();
+
+protected:
+  /** The client metrics holding the latency histograms. */
+  Metrics &_metrics;
+  /** One row per origin. */
+  QTableWidget *_table;
+  /** Hits and misses of the address cache. */
+  QLabel *_cache;
+
+  QTimer _updateTimer;
+};
+
+
+/** Shows the fill, average node age and the rates of nodes joining and leaving each k-bucket. */
+class DHTBucketView : public QWidget
+{
+  Q_OBJECT
+
+public:
+  explicit DHTBucketView(Application &app, QWidget *parent = 0);
+
+protected slots:
+  void _onUpdate();
+
+protected:
+  DHTStatus *_status;
+  /** Describes the time span of the rates. */
+  QLabel *_info;
+  /** One row per non-empty bucket. */
+  QTableWidget *_table;
+
+  QTimer _updateTimer;
+};
+
 #endif // DHTSTATUSVIEW_H
@@ -0,0 +1,26 @@
+#include "eventloopprobe.hh"
+#include "metrics.hh"
+
+// Interval (ms) of the probe
+#define EVENTLOOPPROBE_INTERVAL 100
+
+
+EventLoopProbe::EventLoopProbe(Metrics &metrics, QObject *parent)
+  : QObject(parent), _metrics(metrics), _timer(), _elapsed()
+{
+  _timer.setInterval(EVENTLOOPPROBE_INTERVAL);
+  _timer.setSingleShot(true);
+  // Coarse timers may be off by 5% of the interval
+  _timer.setTimerType(Qt::PreciseTimer);
+  connect(&_timer, SIGNAL(timeout()), this, SLOT(_onTimeout()));
+  _elapsed.start();
+  _timer.start();
+}
+
+void
+EventLoopProbe::_onTimeout() {
+  qint64 delay = _elapsed.elapsed() - EVENTLOOPPROBE_INTERVAL;
+  _metrics.eventLoopDelay(delay);
+  _elapsed.start();
+  _timer.start();
+}
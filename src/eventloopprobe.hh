@@ -0,0 +1,35 @@
+#ifndef EVENTLOOPPROBE_H
+#define EVENTLOOPPROBE_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+
+// forward declarations
+class Metrics;
+
+
+/** Measures the delay of the event loop of the thread it lives in. A timer is scheduled in
+ * short intervals, the time it fires late is the time any other event (e.g., a received
+ * packet) had to wait. The delays are recorded into a latency histogram of the metrics. */
+class EventLoopProbe : public QObject
+{
+  Q_OBJECT
+
+public:
+  /** Constructor. */
+  explicit EventLoopProbe(Metrics &metrics, QObject *parent=0);
+
+protected slots:
+  void _onTimeout();
+
+protected:
+  /** The metrics to record into. */
+  Metrics &_metrics;
+  /** The probe timer. */
+  QTimer _timer;
+  /** Time since the timer was started. */
+  QElapsedTimer _elapsed;
+};
+
+#endif // EVENTLOOPPROBE_H
@@ -0,0 +1,242 @@
+#include "exporter.hh"
+#include "application.hh"
+#include <ovlnet/logger.hh>
+#include <QHostAddress>
+
+// Maximum size of a request header
+#define EXPORTER_MAX_REQUEST 8192
+
+
+/* Appends the metadata of a metric family. */
+static void
+family(QByteArray &out, const char *name, const char *type, const char *help) {
+  out.append("# TYPE ").append(name).append(' ').append(type).append('\n');
+  out.append("# HELP ").append(name).append(' ').append(help).append('\n');
+}
+
+/* Appends a single sample. */
+static void
+sample(QByteArray &out, const char *name, qint64 value, const char *labels=0) {
+  out.append(name);
+  if (labels) { out.append('{').append(labels).append('}'); }
+  out.append(' ').append(QByteArray::number(value)).append('\n');
+}
+
+/* Appends the samples of a latency histogram (ms), exported in seconds. */
+static void
+histogram(QByteArray &out, const char *name, const LatencyHistogram &hist,
+          const QByteArray &labels)
+{
+  static const qint64 bounds[] = { 1, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000,
+                                   30000, 60000, 0 };
+  QByteArray bucket = QByteArray(name) + "_bucket";
+  QByteArray prefix = labels.isEmpty() ? QByteArray() : (labels + ",");
+  for (int i=0; bounds[i]; i++) {
+    QByteArray le = prefix + "le=\"" + QByteArray::number(bounds[i]/1000.) + "\"";
+    sample(out, bucket.constData(), hist.countBelow(bounds[i]), le.constData());
+  }
+  QByteArray inf = prefix + "le=\"+Inf\"";
+  sample(out, bucket.constData(), hist.count(), inf.constData());
+  QByteArray suffix = labels.isEmpty() ? QByteArray(" ") : ("{" + labels + "} ");
+  out.append(name).append("_sum").append(suffix)
+      .append(QByteArray::number(hist.sum()/1000.)).append('\n');
+  out.append(name).append("_count").append(suffix)
+      .append(QByteArray::number(hist.count())).append('\n');
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of MetricsServer
+ * ********************************************************************************************* */
+MetricsServer::MetricsServer(Metrics &metrics, LogModel &log, QObject *exporter)
+  : QTcpServer(0), _metrics(metrics), _log(log), _exporter(exporter), _requests()
+{
+  connect(this, SIGNAL(newConnection()), this, SLOT(_onNewConnection()));
+}
+
+void
+MetricsServer::start(quint16 port) {
+  stop();
+  // Serve local clients only
+  if (! listen(QHostAddress::LocalHost, port)) {
+    // Do not log from this thread, the log model is not thread safe.
+    QMetaObject::invokeMethod(_exporter, "_onListenFailed", Qt::QueuedConnection,
+                              Q_ARG(QString, errorString()));
+  }
+}
+
+void
+MetricsServer::stop() {
+  close();
+  QHash<QTcpSocket *, QByteArray>::iterator request = _requests.begin();
+  for (; request != _requests.end(); request++) {
+    request.key()->abort();
+    request.key()->deleteLater();
+  }
+  _requests.clear();
+}
+
+void
+MetricsServer::_onNewConnection() {
+  while (hasPendingConnections()) {
+    QTcpSocket *socket = nextPendingConnection();
+    _requests.insert(socket, QByteArray());
+    connect(socket, SIGNAL(readyRead()), this, SLOT(_onReadyRead()));
+    connect(socket, SIGNAL(disconnected()), this, SLOT(_onDisconnected()));
+  }
+}
+
+void
+MetricsServer::_onReadyRead() {
+  QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+  if ((0 == socket) || (! _requests.contains(socket))) { return; }
+  QByteArray &request = _requests[socket];
+  request.append(socket->readAll());
+  if (request.size() > EXPORTER_MAX_REQUEST) {
+    _requests.remove(socket);
+    socket->abort(); socket->deleteLater();
+    return;
+  }
+  // Wait for the complete header
+  if (! request.contains("\r\n\r\n")) { return; }
+  QByteArray line = request.left(request.indexOf("\r\n"));
+  _requests.remove(socket);
+  _respond(socket, line);
+}
+
+void
+MetricsServer::_onDisconnected() {
+  QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+  if (0 == socket) { return; }
+  _requests.remove(socket);
+  socket->deleteLater();
+}
+
+void
+MetricsServer::_respond(QTcpSocket *socket, const QByteArray &request) {
+  QList<QByteArray> parts = request.split(' ');
+  QByteArray response;
+  if ((3 == parts.size()) && ("GET" == parts[0]) && ("/metrics" == parts[1])) {
+    QByteArray body = render();
+    response.append("HTTP/1.0 200 OK\r\n"
+                    "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n");
+    response.append("Content-Length: ").append(QByteArray::number(body.size())).append("\r\n");
+    response.append("Connection: close\r\n\r\n");
+    response.append(body);
+  } else {
+    response.append("HTTP/1.0 404 Not Found\r\n"
+                    "Content-Length: 0\r\n"
+                    "Connection: close\r\n\r\n");
+  }
+  socket->write(response);
+  socket->disconnectFromHost();
+}
+
+QByteArray
+MetricsServer::render() const {
+  QByteArray out;
+
+  // Status of the node
+  family(out, "ovl_peers", "gauge", "Number of peers in the routing table.");
+  sample(out, "ovl_peers", _metrics.gauge(Metrics::PEERS));
+  family(out, "ovl_streams", "gauge", "Number of open streams of the node.");
+  sample(out, "ovl_streams", _metrics.gauge(Metrics::STREAMS));
+  family(out, "ovl_received_bytes", "counter", "Bytes received by the node.");
+  sample(out, "ovl_received_bytes_total", _metrics.gauge(Metrics::BYTES_RECEIVED));
+  family(out, "ovl_sent_bytes", "counter", "Bytes sent by the node.");
+  sample(out, "ovl_sent_bytes_total", _metrics.gauge(Metrics::BYTES_SEND));
+  family(out, "ovl_receive_rate_bytes_per_second", "gauge", "Current receive rate of the node.");
+  sample(out, "ovl_receive_rate_bytes_per_second", _metrics.gauge(Metrics::IN_RATE));
+  family(out, "ovl_send_rate_bytes_per_second", "gauge", "Current send rate of the node.");
+  sample(out, "ovl_send_rate_bytes_per_second", _metrics.gauge(Metrics::OUT_RATE));
+
+  // Services
+  family(out, "ovl_service_streams", "gauge", "Number of open streams per service.");
+  for (int i=0; i<Metrics::NUM_SERVICES; i++) {
+    Metrics::Service service = Metrics::Service(i);
+    QByteArray labels = QByteArray("service=\"") + Metrics::serviceName(service) + "\"";
+    sample(out, "ovl_service_streams", _metrics.streams(service), labels.constData());
+  }
+  family(out, "ovl_transfer_bytes", "counter", "Bytes transferred by file transfers.");
+  sample(out, "ovl_transfer_bytes_total", _metrics.bytesTransferred(Metrics::UPLOAD),
+         "direction=\"upload\"");
+  sample(out, "ovl_transfer_bytes_total", _metrics.bytesTransferred(Metrics::DOWNLOAD),
+         "direction=\"download\"");
+
+  // Buddies
+  family(out, "ovl_buddies", "gauge", "Number of buddies.");
+  sample(out, "ovl_buddies", _metrics.gauge(Metrics::BUDDIES));
+  family(out, "ovl_buddies_online", "gauge", "Number of buddies with a reachable node.");
+  sample(out, "ovl_buddies_online", _metrics.gauge(Metrics::BUDDIES_ONLINE));
+
+  // Lookups
+  family(out, "ovl_lookup_duration_seconds", "histogram", "Duration of node lookups.");
+  for (int i=0; i<Metrics::NUM_LOOKUPS; i++) {
+    Metrics::Lookup origin = Metrics::Lookup(i);
+    QByteArray labels = QByteArray("origin=\"") + Metrics::lookupName(origin) + "\"";
+    histogram(out, "ovl_lookup_duration_seconds", _metrics.lookups(origin, true),
+              labels + ",result=\"found\"");
+    histogram(out, "ovl_lookup_duration_seconds", _metrics.lookups(origin, false),
+              labels + ",result=\"failed\"");
+  }
+
+  // Event loop of the GUI thread (also handles the packets of the node)
+  family(out, "ovl_event_loop_delay_seconds", "histogram",
+         "Delay of events in the GUI thread, including packet handling.");
+  histogram(out, "ovl_event_loop_delay_seconds", _metrics.eventLoopDelays(), QByteArray());
+
+  // Address cache
+  family(out, "ovl_address_cache_hits", "counter", "Connections started without a lookup.");
+  sample(out, "ovl_address_cache_hits_total", _metrics.count(Metrics::ADDRESS_CACHE_HITS));
+  family(out, "ovl_address_cache_misses", "counter", "Addresses not found in the cache.");
+  sample(out, "ovl_address_cache_misses_total", _metrics.count(Metrics::ADDRESS_CACHE_MISSES));
+
+  // Log messages
+  family(out, "ovl_log_messages", "counter", "Log messages per level.");
+  sample(out, "ovl_log_messages_total", _log.count(LogMessage::DEBUG), "level=\"debug\"");
+  sample(out, "ovl_log_messages_total", _log.count(LogMessage::INFO), "level=\"info\"");
+  sample(out, "ovl_log_messages_total", _log.count(LogMessage::WARNING), "level=\"warning\"");
+  sample(out, "ovl_log_messages_total", _log.count(LogMessage::ERROR), "level=\"error\"");
+
+  out.append("# EOF\n");
+  return out;
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of MetricsExporter
+ * ********************************************************************************************* */
+MetricsExporter::MetricsExporter(Application &app, QObject *parent)
+  : QObject(parent), _settings(app.settings().metricsSettings()), _thread(), _server(0)
+{
+  _server = new MetricsServer(app.metrics(), app.log(), this);
+  _server->moveToThread(&_thread);
+  connect(&_thread, SIGNAL(finished()), _server, SLOT(deleteLater()));
+  _thread.start();
+
+  connect(&_settings, SIGNAL(modified()), this, SLOT(_onSettingsChanged()));
+  _onSettingsChanged();
+}
+
+MetricsExporter::~MetricsExporter() {
+  QMetaObject::invokeMethod(_server, "stop", Qt::QueuedConnection);
+  _thread.quit();
+  _thread.wait();
+}
+
+void
+MetricsExporter::_onSettingsChanged() {
+  if (_settings.enabled()) {
+    logInfo() << "MetricsExporter: Serve metrics at http://localhost:" << _settings.port()
+              << "/metrics";
+    QMetaObject::invokeMethod(_server, "start", Qt::QueuedConnection,
+                              Q_ARG(quint16, _settings.port()));
+  } else {
+    QMetaObject::invokeMethod(_server, "stop", Qt::QueuedConnection);
+  }
+}
+
+void
+MetricsExporter::_onListenFailed(const QString &error) {
+  logError() << "MetricsExporter: Cannot listen on port " << _settings.port() << ": " << error;
+}
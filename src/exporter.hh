@@ -0,0 +1,84 @@
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThread>
+#include <QHash>
+#include "metrics.hh"
+#include "logwindow.hh"
+
+// forward declarations
+class Application;
+class MetricsSettings;
+
+
+/** A minimal HTTP server, serving the client metrics in the OpenMetrics text format at
+ * "/metrics". The server lives in its own thread and only reads atomic counters, hence a scrape
+ * never touches the GUI thread. */
+class MetricsServer: public QTcpServer
+{
+  Q_OBJECT
+
+public:
+  /** Constructor. */
+  MetricsServer(Metrics &metrics, LogModel &log, QObject *exporter);
+
+  /** Renders the current metrics. */
+  QByteArray render() const;
+
+public slots:
+  /** Starts listening on the given local port. */
+  void start(quint16 port);
+  /** Stops listening and closes all connections. */
+  void stop();
+
+protected slots:
+  void _onNewConnection();
+  void _onReadyRead();
+  void _onDisconnected();
+
+protected:
+  /** Sends the response for the given request line and closes the connection. */
+  void _respond(QTcpSocket *socket, const QByteArray &request);
+
+protected:
+  /** The counters of the client. */
+  Metrics &_metrics;
+  /** The log model (counts messages per level). */
+  LogModel &_log;
+  /** Receives errors (in the GUI thread). */
+  QObject *_exporter;
+  /** Requests received so far, per connection. */
+  QHash<QTcpSocket *, QByteArray> _requests;
+};
+
+
+/** Runs the @c MetricsServer in a separate thread, if enabled in the settings. */
+class MetricsExporter: public QObject
+{
+  Q_OBJECT
+
+public:
+  /** Constructor. */
+  explicit MetricsExporter(Application &app, QObject *parent=0);
+  /** Destructor, stops the server thread. */
+  virtual ~MetricsExporter();
+
+protected slots:
+  /** (Re-)Starts or stops the server according to the settings. */
+  void _onSettingsChanged();
+  /** Gets called by the server if it cannot listen on the port. */
+  void _onListenFailed(const QString &error);
+
+protected:
+  /** The exporter settings. */
+  MetricsSettings &_settings;
+  /** The thread of the server. */
+  QThread _thread;
+  /** The server, owned by the thread. */
+  MetricsServer *_server;
+};
+
+#endif // EXPORTER_H
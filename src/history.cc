@@ -0,0 +1,142 @@
+#include "history.hh"
+#include "application.hh"
+#include <limits>
+#include <algorithm>
+
+// Interval (ms) between two samples
+#define HISTORY_SAMPLE_INTERVAL 1000
+
+// Resolution (in seconds) and length of the ring buffers
+static const int resolutions[TimeSeries::NUM_LEVELS] = { 1, 60, 3600 };
+static const int lengths[TimeSeries::NUM_LEVELS] = { 3600, 1440, 720 };
+
+
+/* ********************************************************************************************* *
+ * Implementation of TimeSeries
+ * ********************************************************************************************* */
+TimeSeries::TimeSeries()
+{
+  Bucket empty;
+  empty.min = std::numeric_limits<float>::max();
+  empty.max = -std::numeric_limits<float>::max();
+  empty.sum = 0; empty.count = 0;
+  for (int i=0; i<NUM_LEVELS; i++) {
+    _rings[i].buckets.fill(empty, lengths[i]);
+    _rings[i].head = 0;
+    _rings[i].slot = -1;
+  }
+}
+
+void
+TimeSeries::add(qint64 time, double value) {
+  for (int i=0; i<NUM_LEVELS; i++) {
+    Ring &ring = _rings[i];
+    qint64 slot = time / resolutions[i];
+    if (slot < ring.slot) { return; }
+    if (ring.slot < 0) {
+      ring.slot = slot;
+    }
+    // Advance to the current slot, clearing the buckets skipped
+    qint64 steps = std::min(slot - ring.slot, qint64(lengths[i]));
+    for (qint64 j=0; j<steps; j++) {
+      ring.head = (ring.head+1) % lengths[i];
+      Bucket &bucket = ring.buckets[ring.head];
+      bucket.min = std::numeric_limits<float>::max();
+      bucket.max = -std::numeric_limits<float>::max();
+      bucket.sum = 0; bucket.count = 0;
+    }
+    ring.slot = slot;
+    // Update current bucket
+    Bucket &bucket = ring.buckets[ring.head];
+    bucket.min = std::min(bucket.min, float(value));
+    bucket.max = std::max(bucket.max, float(value));
+    bucket.sum += value;
+    bucket.count++;
+  }
+}
+
+QVector<TimeSeries::Bucket>
+TimeSeries::buckets(Level level) const {
+  const Ring &ring = _rings[level];
+  QVector<Bucket> result; result.reserve(lengths[level]);
+  for (int i=1; i<=lengths[level]; i++) {
+    result.append(ring.buckets[(ring.head+i) % lengths[level]]);
+  }
+  return result;
+}
+
+int
+TimeSeries::resolution(Level level) {
+  return resolutions[level];
+}
+
+int
+TimeSeries::length(Level level) {
+  return lengths[level];
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of MetricsHistory
+ * ********************************************************************************************* */
+MetricsHistory::MetricsHistory(Application &app, QObject *parent)
+  : QObject(parent), _application(app), _clock(), _timer()
+{
+  _clock.start();
+  _timer.setInterval(HISTORY_SAMPLE_INTERVAL);
+  _timer.setSingleShot(false);
+  connect(&_timer, SIGNAL(timeout()), this, SLOT(_onSample()));
+  _timer.start();
+}
+
+const TimeSeries &
+MetricsHistory::series(Series series) const {
+  return _series[series];
+}
+
+QString
+MetricsHistory::name(Series series) {
+  switch (series) {
+  case IN_RATE: return tr("In rate");
+  case OUT_RATE: return tr("Out rate");
+  case PEERS: return tr("Peers");
+  case STREAMS: return tr("Streams");
+  case CHATS: return tr("Chats");
+  case CALLS: return tr("Calls");
+  case UPLOADS: return tr("Uploads");
+  case DOWNLOADS: return tr("Downloads");
+  default: break;
+  }
+  return QString();
+}
+
+void
+MetricsHistory::_onSample() {
+  qint64 now = _clock.elapsed()/1000;
+  DHTStatus &status = _application.status();
+  Metrics &metrics = _application.metrics();
+
+  // Publish the status of the node, so that it can be read from other threads
+  metrics.setGauge(Metrics::PEERS, status.numNeighbors());
+  metrics.setGauge(Metrics::STREAMS, status.numStreams());
+  metrics.setGauge(Metrics::BYTES_RECEIVED, status.bytesReceived());
+  metrics.setGauge(Metrics::BYTES_SEND, status.bytesSend());
+  metrics.setGauge(Metrics::IN_RATE, status.inRate());
+  metrics.setGauge(Metrics::OUT_RATE, status.outRate());
+  BuddyList &buddies = _application.buddies();
+  size_t online = 0;
+  for (size_t i=0; i<buddies.numBuddies(); i++) {
+    if (buddies.getBuddy(i)->isReachable()) { online++; }
+  }
+  metrics.setGauge(Metrics::BUDDIES, buddies.numBuddies());
+  metrics.setGauge(Metrics::BUDDIES_ONLINE, online);
+
+  _series[IN_RATE].add(now, status.inRate());
+  _series[OUT_RATE].add(now, status.outRate());
+  _series[PEERS].add(now, status.numNeighbors());
+  _series[STREAMS].add(now, status.numStreams());
+  _series[CHATS].add(now, metrics.streams(Metrics::CHAT));
+  _series[CALLS].add(now, metrics.streams(Metrics::CALL));
+  _series[UPLOADS].add(now, metrics.streams(Metrics::UPLOAD));
+  _series[DOWNLOADS].add(now, metrics.streams(Metrics::DOWNLOAD));
+}
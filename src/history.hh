@@ -0,0 +1,107 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <QObject>
+#include <QVector>
+#include <QTimer>
+#include <QElapsedTimer>
+
+// forward declarations
+class Application;
+
+
+/** A time series of fixed memory size. The samples are aggregated into several ring buffers of
+ * increasing resolution (1s for an hour, 1min for a day and 1h for a month). Each bucket keeps
+ * the minimum, maximum and sum of the samples it covers. */
+class TimeSeries
+{
+public:
+  /** A single bucket of the time series. */
+  typedef struct {
+    /** Minimum of the samples. */
+    float min;
+    /** Maximum of the samples. */
+    float max;
+    /** Sum of the samples. */
+    float sum;
+    /** Number of samples, 0 if the bucket is empty. */
+    quint32 count;
+  } Bucket;
+
+  /** The resolutions of the time series. */
+  typedef enum {
+    SECONDS = 0, MINUTES, HOURS,
+    NUM_LEVELS
+  } Level;
+
+public:
+  /** Constructor. */
+  TimeSeries();
+
+  /** Adds a sample at the given time (in seconds). Samples older than the last one are
+   * ignored. */
+  void add(qint64 time, double value);
+
+  /** Returns the buckets of the given level, the oldest first. */
+  QVector<Bucket> buckets(Level level) const;
+  /** Returns the interval (in seconds) covered by a bucket of the given level. */
+  static int resolution(Level level);
+  /** Returns the number of buckets of the given level. */
+  static int length(Level level);
+
+protected:
+  /** A single ring buffer. */
+  typedef struct {
+    /** The buckets. */
+    QVector<Bucket> buckets;
+    /** Index of the current bucket. */
+    int head;
+    /** Time slot of the current bucket. */
+    qint64 slot;
+  } Ring;
+
+protected:
+  /** The ring buffers, one for each level. */
+  Ring _rings[NUM_LEVELS];
+};
+
+
+/** Samples the traffic, peers and streams of the node and the open streams of each service
+ * every second into time series. The samples are also published as gauges of the client
+ * metrics. */
+class MetricsHistory : public QObject
+{
+  Q_OBJECT
+
+public:
+  /** The series recorded. */
+  typedef enum {
+    IN_RATE = 0, OUT_RATE, PEERS, STREAMS, CHATS, CALLS, UPLOADS, DOWNLOADS,
+    NUM_SERIES
+  } Series;
+
+public:
+  /** Constructor. */
+  explicit MetricsHistory(Application &app, QObject *parent=0);
+
+  /** Returns the given series. */
+  const TimeSeries &series(Series series) const;
+  /** Returns the name of the given series. */
+  static QString name(Series series);
+
+protected slots:
+  /** Takes a sample of all series. */
+  void _onSample();
+
+protected:
+  /** A weak reference to the application. */
+  Application &_application;
+  /** The time series. */
+  TimeSeries _series[NUM_SERIES];
+  /** Monotonic time since the history started. */
+  QElapsedTimer _clock;
+  /** The sample timer. */
+  QTimer _timer;
+};
+
+#endif // HISTORY_H
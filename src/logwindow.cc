@@ -82,11 +82,28 @@ LogModel::headerData(int section, Qt::Orientation orientation, int role) const {
 
 void
 LogModel::handleMessage(const LogMessage &msg) {
+  _counts[_index(msg.level())].ref();
   this->beginInsertRows(QModelIndex(), _messages.size(), _messages.size());
   _messages.append(msg);
   this->endInsertRows();
 }
 
+size_t
+LogModel::count(LogMessage::Level level) const {
+  return _counts[_index(level)].load();
+}
+
+int
+LogModel::_index(LogMessage::Level level) {
+  switch (level) {
+  case LogMessage::DEBUG: return 0;
+  case LogMessage::INFO: return 1;
+  case LogMessage::WARNING: return 2;
+  case LogMessage::ERROR: return 3;
+  }
+  return 0;
+}
+
 
 
 LogWidget::LogWidget(Application &app)
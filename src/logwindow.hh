@@ -4,6 +4,7 @@
 #include <QWidget>
 #include <QAbstractTableModel>
 #include <QTableView>
+#include <QAtomicInt>
 #include <ovlnet/logger.hh>
 
 class Application;
@@ -18,14 +19,23 @@ public:
   virtual ~LogModel();
 
   void handleMessage(const LogMessage &msg);
+  /** Returns the number of messages received with the given level. Can be called from any
+   * thread. */
+  size_t count(LogMessage::Level level) const;
 
   int rowCount(const QModelIndex &parent) const;
   int columnCount(const QModelIndex &parent) const;
   QVariant data(const QModelIndex &index, int role) const;
   QVariant headerData(int section, Qt::Orientation orientation, int role) const;
 
+protected:
+  /** Maps a log level to an index of the counters. */
+  static int _index(LogMessage::Level level);
+
 protected:
   QVector<LogMessage> _messages;
+  /** Number of messages per level. */
+  QAtomicInt _counts[4];
 };
 
 
@@ -0,0 +1,102 @@
+#include "lookupmonitor.hh"
+#include "application.hh"
+#include <ovlnet/logger.hh>
+#include <QCoreApplication>
+#include <QDateTime>
+
+// Interval (ms) to append completed lookups to the CSV file
+#define LOOKUPMONITOR_FLUSH_INTERVAL (1000*60)
+// Size of the CSV file, before it gets rotated
+#define LOOKUPMONITOR_MAX_FILE_SIZE  (4*1024*1024)
+
+
+LookupMonitor::LookupMonitor(Application &app, const QString &filename, QObject *parent)
+  : QObject(parent), _application(app), _clock(), _pending(), _file(filename),
+    _buffer(), _flushTimer()
+{
+  _clock.start();
+
+  _flushTimer.setInterval(LOOKUPMONITOR_FLUSH_INTERVAL);
+  _flushTimer.setSingleShot(false);
+  connect(&_flushTimer, SIGNAL(timeout()), this, SLOT(flush()));
+  _flushTimer.start();
+  if (QCoreApplication::instance()) {
+    connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()), this, SLOT(flush()));
+  }
+}
+
+void
+LookupMonitor::search(FindNodeQuery *query, Metrics::Lookup origin) {
+  Pending pending;
+  pending.started = QDateTime::currentMSecsSinceEpoch();
+  pending.start = _clock.elapsed();
+  pending.origin = origin;
+  _pending.insert(query, pending);
+  connect(query, SIGNAL(found(NodeItem)), this, SLOT(_onFound(NodeItem)));
+  connect(query, SIGNAL(failed(Identifier,QList<NodeItem>)),
+          this, SLOT(_onFailed(Identifier,QList<NodeItem>)));
+  connect(query, SIGNAL(destroyed(QObject*)), this, SLOT(_onQueryDestroyed(QObject*)));
+  _application.dht().search(query);
+}
+
+void
+LookupMonitor::_onFound(const NodeItem &node) {
+  _application.addresses().addFound(node);
+  _completed(sender(), true, 0);
+}
+
+void
+LookupMonitor::_onFailed(const Identifier &id, const QList<NodeItem> &best) {
+  _completed(sender(), false, best.size());
+}
+
+void
+LookupMonitor::_onQueryDestroyed(QObject *query) {
+  // Query was dropped without a result
+  _pending.remove(query);
+}
+
+void
+LookupMonitor::_completed(QObject *query, bool found, int numBest) {
+  if (! _pending.contains(query)) { return; }
+  Pending pending = _pending.take(query);
+
+  Record record;
+  record.started = pending.started;
+  record.duration = _clock.elapsed() - pending.start;
+  record.origin = pending.origin;
+  record.found = found;
+  record.numBest = numBest;
+
+  _application.metrics().lookupCompleted(record.origin, found, record.duration);
+
+  _buffer.append(QByteArray::number(record.started)).append(',')
+      .append(Metrics::lookupName(record.origin)).append(',')
+      .append(found ? "found" : "failed").append(',')
+      .append(QByteArray::number(record.duration)).append(',')
+      .append(QByteArray::number(numBest)).append('\n');
+}
+
+void
+LookupMonitor::flush() {
+  if (_buffer.isEmpty()) { return; }
+  // Keep the previous file on rotation
+  if (_file.exists() && (_file.size() > LOOKUPMONITOR_MAX_FILE_SIZE)) {
+    QFile::remove(_file.fileName()+".1");
+    QFile::rename(_file.fileName(), _file.fileName()+".1");
+  }
+  bool header = (! _file.exists());
+  if (! _file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+    logWarning() << "LookupMonitor: Cannot open " << _file.fileName() << ": "
+                 << _file.errorString();
+    // Do not accumulate lines forever
+    if (_buffer.size() > LOOKUPMONITOR_MAX_FILE_SIZE) { _buffer.clear(); }
+    return;
+  }
+  if (header) {
+    _file.write("started,origin,result,duration_ms,num_best\n");
+  }
+  _file.write(_buffer);
+  _file.close();
+  _buffer.clear();
+}
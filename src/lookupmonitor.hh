@@ -0,0 +1,85 @@
+#ifndef LOOKUPMONITOR_H
+#define LOOKUPMONITOR_H
+
+#include <QObject>
+#include <QHash>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QFile>
+#include <ovlnet/node.hh>
+#include "metrics.hh"
+
+// forward declarations
+class Application;
+
+
+/** Measures the duration and result of node lookups. Every @c FindNodeQuery issued by the
+ * client is passed to @c search, which starts the query and records its outcome. Completed
+ * lookups feed the latency histograms of the client metrics and are appended to a CSV file. */
+class LookupMonitor : public QObject
+{
+  Q_OBJECT
+
+public:
+  /** A completed lookup. */
+  typedef struct {
+    /** Start time (ms since epoch). */
+    qint64 started;
+    /** Duration in ms. */
+    qint64 duration;
+    /** Who issued the lookup. */
+    Metrics::Lookup origin;
+    /** If @c true, the node was found. */
+    bool found;
+    /** Number of closest nodes returned by a failed lookup. */
+    int numBest;
+  } Record;
+
+public:
+  /** Constructor.
+   * @param filename Specifies the CSV file, the lookups are appended to. */
+  LookupMonitor(Application &app, const QString &filename, QObject *parent=0);
+
+  /** Starts the given query and tracks it. */
+  void search(FindNodeQuery *query, Metrics::Lookup origin);
+
+public slots:
+  /** Appends all completed lookups to the CSV file. */
+  void flush();
+
+protected slots:
+  void _onFound(const NodeItem &node);
+  void _onFailed(const Identifier &id, const QList<NodeItem> &best);
+  void _onQueryDestroyed(QObject *query);
+
+protected:
+  /** Records the completion of the given query. */
+  void _completed(QObject *query, bool found, int numBest);
+
+protected:
+  /** A pending lookup. */
+  typedef struct {
+    /** Start time (ms since epoch). */
+    qint64 started;
+    /** Start time (ms of the monotonic clock). */
+    qint64 start;
+    /** Who issued the lookup. */
+    Metrics::Lookup origin;
+  } Pending;
+
+protected:
+  /** A weak reference to the application. */
+  Application &_application;
+  /** Monotonic clock for durations. */
+  QElapsedTimer _clock;
+  /** The pending lookups. */
+  QHash<QObject *, Pending> _pending;
+  /** The CSV file. */
+  QFile _file;
+  /** CSV lines not written yet. */
+  QByteArray _buffer;
+  /** Timer to write the CSV file periodically. */
+  QTimer _flushTimer;
+};
+
+#endif // LOOKUPMONITOR_H
@@ -0,0 +1,183 @@
+#include "metrics.hh"
+#include <algorithm>
+
+
+/* ********************************************************************************************* *
+ * Implementation of LatencyHistogram
+ * ********************************************************************************************* */
+LatencyHistogram::LatencyHistogram()
+{
+  for (int i=0; i<NUM_BUCKETS; i++) {
+    _buckets[i].store(0);
+  }
+  _count.store(0);
+  _sum.store(0);
+}
+
+void
+LatencyHistogram::add(qint64 value) {
+  if (value < 0) { value = 0; }
+  _buckets[_index(value)].ref();
+  _sum.fetchAndAddRelaxed(value);
+  _count.ref();
+}
+
+qint64
+LatencyHistogram::count() const {
+  return _count.load();
+}
+
+qint64
+LatencyHistogram::sum() const {
+  return _sum.load();
+}
+
+qint64
+LatencyHistogram::countBelow(qint64 value) const {
+  qint64 n = 0;
+  for (int i=0; (i<NUM_BUCKETS) && (_upperBound(i) <= value+1); i++) {
+    n += _buckets[i].load();
+  }
+  return n;
+}
+
+qint64
+LatencyHistogram::quantile(double q) const {
+  qint64 total = count();
+  if (0 == total) { return 0; }
+  qint64 rank = std::min(qint64(q*total), total-1), n = 0;
+  for (int i=0; i<NUM_BUCKETS; i++) {
+    n += _buckets[i].load();
+    if (n > rank) { return _upperBound(i)-1; }
+  }
+  return _upperBound(NUM_BUCKETS-1)-1;
+}
+
+int
+LatencyHistogram::_index(qint64 value) {
+  // Values below 16 get a bucket each
+  if (value < 16) { return int(value); }
+  // Above, each power of two 2^(k+4) is divided into 16 buckets of width 2^k
+  int msb = 4;
+  while ((msb < 20) && (value >> (msb+1))) { msb++; }
+  int k = msb-4;
+  if (value >> (msb+1)) { return NUM_BUCKETS-1; }
+  return 16 + 16*k + int((value >> k) - 16);
+}
+
+qint64
+LatencyHistogram::_upperBound(int index) {
+  if (index < 16) { return index+1; }
+  int k = (index-16)/16;
+  qint64 sub = (index-16)%16 + 16;
+  return (sub+1) << k;
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of Metrics
+ * ********************************************************************************************* */
+
+Metrics::Metrics()
+{
+  for (int i=0; i<NUM_SERVICES; i++) {
+    _streams[i].store(0);
+    _transferred[i].store(0);
+  }
+  for (int i=0; i<NUM_GAUGES; i++) {
+    _gauges[i].store(0);
+  }
+  for (int i=0; i<NUM_COUNTERS; i++) {
+    _counters[i].store(0);
+  }
+}
+
+void
+Metrics::streamOpened(Service service) {
+  _streams[service].ref();
+}
+
+void
+Metrics::streamClosed(Service service) {
+  _streams[service].deref();
+}
+
+int
+Metrics::streams(Service service) const {
+  return _streams[service].load();
+}
+
+void
+Metrics::transferred(Service service, qint64 bytes) {
+  _transferred[service].fetchAndAddRelaxed(bytes);
+}
+
+qint64
+Metrics::bytesTransferred(Service service) const {
+  return _transferred[service].load();
+}
+
+void
+Metrics::setGauge(Gauge gauge, qint64 value) {
+  _gauges[gauge].store(value);
+}
+
+qint64
+Metrics::gauge(Gauge gauge) const {
+  return _gauges[gauge].load();
+}
+
+void
+Metrics::increment(Counter counter) {
+  _counters[counter].ref();
+}
+
+qint64
+Metrics::count(Counter counter) const {
+  return _counters[counter].load();
+}
+
+void
+Metrics::eventLoopDelay(qint64 delay) {
+  _eventLoopDelays.add(delay);
+}
+
+const LatencyHistogram &
+Metrics::eventLoopDelays() const {
+  return _eventLoopDelays;
+}
+
+void
+Metrics::lookupCompleted(Lookup origin, bool found, qint64 duration) {
+  _lookups[origin][found ? 1 : 0].add(duration);
+}
+
+const LatencyHistogram &
+Metrics::lookups(Lookup origin, bool found) const {
+  return _lookups[origin][found ? 1 : 0];
+}
+
+const char *
+Metrics::serviceName(Service service) {
+  switch (service) {
+  case CHAT: return "chat";
+  case CALL: return "call";
+  case UPLOAD: return "upload";
+  case DOWNLOAD: return "download";
+  default: break;
+  }
+  return "unknown";
+}
+
+const char *
+Metrics::lookupName(Lookup origin) {
+  switch (origin) {
+  case LOOKUP_SEARCH: return "search";
+  case LOOKUP_BUDDIES: return "buddies";
+  case LOOKUP_CHAT: return "chat";
+  case LOOKUP_CALL: return "call";
+  case LOOKUP_FILE: return "file";
+  default: break;
+  }
+  return "unknown";
+}
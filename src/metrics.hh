@@ -0,0 +1,136 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QAtomicInt>
+#include <QAtomicInteger>
+
+
+/** A latency histogram with log-linear buckets (as HDR histograms). Each power of two is
+ * divided into 16 buckets, hence the relative error of a value is below 1/16. Values are in
+ * milliseconds up to about 35 minutes. All counters are atomic. */
+class LatencyHistogram
+{
+public:
+  /** Number of buckets. */
+  static const int NUM_BUCKETS = 16 + 17*16;
+
+public:
+  /** Constructor. */
+  LatencyHistogram();
+
+  /** Adds a value (in ms). */
+  void add(qint64 value);
+
+  /** Returns the number of values. */
+  qint64 count() const;
+  /** Returns the sum of all values (in ms). */
+  qint64 sum() const;
+  /** Returns the number of values less or equal to the given value (in ms). The boundaries
+   * are rounded down to the boundaries of the buckets. */
+  qint64 countBelow(qint64 value) const;
+  /** Returns an upper bound of the given quantile (in ms), 0 if the histogram is empty. */
+  qint64 quantile(double q) const;
+
+protected:
+  /** Returns the bucket of the given value. */
+  static int _index(qint64 value);
+  /** Returns the (exclusive) upper bound of the given bucket. */
+  static qint64 _upperBound(int index);
+
+protected:
+  /** The number of values per bucket. */
+  QAtomicInteger<qint64> _buckets[NUM_BUCKETS];
+  /** The number of values. */
+  QAtomicInteger<qint64> _count;
+  /** The sum of the values. */
+  QAtomicInteger<qint64> _sum;
+};
+
+
+/** Collects some counters of the client. All counters are atomic, hence they can be read
+ * from any thread. Values only known to the GUI thread (e.g., the status of the node) are
+ * published here periodically as gauges. */
+class Metrics
+{
+public:
+  /** The services of the client. */
+  typedef enum {
+    CHAT = 0, CALL, UPLOAD, DOWNLOAD,
+    NUM_SERVICES
+  } Service;
+
+  /** The gauges published. */
+  typedef enum {
+    PEERS = 0, STREAMS, BYTES_RECEIVED, BYTES_SEND, IN_RATE, OUT_RATE, BUDDIES, BUDDIES_ONLINE,
+    NUM_GAUGES
+  } Gauge;
+
+  /** Event counters. */
+  typedef enum {
+    ADDRESS_CACHE_HITS = 0, ADDRESS_CACHE_MISSES,
+    NUM_COUNTERS
+  } Counter;
+
+  /** The origins of node lookups. */
+  typedef enum {
+    LOOKUP_SEARCH = 0, LOOKUP_BUDDIES, LOOKUP_CHAT, LOOKUP_CALL, LOOKUP_FILE,
+    NUM_LOOKUPS
+  } Lookup;
+
+public:
+  /** Constructor. */
+  Metrics();
+
+  /** Gets called if a stream of the given service was opened. */
+  void streamOpened(Service service);
+  /** Gets called if a stream of the given service was closed. */
+  void streamClosed(Service service);
+  /** Returns the number of open streams of the given service. */
+  int streams(Service service) const;
+
+  /** Adds the given number of bytes to the transferred bytes of the given service. */
+  void transferred(Service service, qint64 bytes);
+  /** Returns the total number of bytes transferred by the given service. */
+  qint64 bytesTransferred(Service service) const;
+
+  /** Publishes the current value of the given gauge. */
+  void setGauge(Gauge gauge, qint64 value);
+  /** Returns the last published value of the given gauge. */
+  qint64 gauge(Gauge gauge) const;
+
+  /** Increments the given counter. */
+  void increment(Counter counter);
+  /** Returns the value of the given counter. */
+  qint64 count(Counter counter) const;
+
+  /** Records the delay (in ms) of the GUI event loop. */
+  void eventLoopDelay(qint64 delay);
+  /** Returns the histogram of the event loop delays. */
+  const LatencyHistogram &eventLoopDelays() const;
+
+  /** Records the duration (in ms) of a completed lookup. */
+  void lookupCompleted(Lookup origin, bool found, qint64 duration);
+  /** Returns the latency histogram of the given lookups. */
+  const LatencyHistogram &lookups(Lookup origin, bool found) const;
+
+  /** Returns the name of the given service. */
+  static const char *serviceName(Service service);
+  /** Returns the name of the given lookup origin. */
+  static const char *lookupName(Lookup origin);
+
+protected:
+  /** Number of open streams per service. */
+  QAtomicInt _streams[NUM_SERVICES];
+  /** Number of bytes transferred per service. */
+  QAtomicInteger<qint64> _transferred[NUM_SERVICES];
+  /** The gauges. */
+  QAtomicInteger<qint64> _gauges[NUM_GAUGES];
+  /** The event counters. */
+  QAtomicInteger<qint64> _counters[NUM_COUNTERS];
+  /** Delays of the GUI event loop. */
+  LatencyHistogram _eventLoopDelays;
+  /** Latency of failed (0) and successful (1) lookups per origin. */
+  LatencyHistogram _lookups[NUM_LOOKUPS][2];
+};
+
+#endif // METRICS_H
@@ -0,0 +1,121 @@
+#include "netmonitor.hh"
+#include <ovlnet/logger.hh>
+#include <QSocketNotifier>
+#include <QNetworkInterface>
+#include <QHostAddress>
+
+#ifdef Q_OS_LINUX
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#endif
+
+// Interval (ms) to poll the interface addresses if netlink is not available
+#define NETMONITOR_POLL_INTERVAL   (1000*10)
+// Delay (ms) until a burst of changes is considered complete
+#define NETMONITOR_SETTLE_DELAY    500
+
+
+NetworkMonitor::NetworkMonitor(QObject *parent)
+  : QObject(parent), _socket(-1), _notifier(0), _pollTimer(), _settleTimer(), _known()
+{
+  _known = _addresses();
+
+  _settleTimer.setInterval(NETMONITOR_SETTLE_DELAY);
+  _settleTimer.setSingleShot(true);
+  connect(&_settleTimer, SIGNAL(timeout()), this, SLOT(_onSettled()));
+
+#ifdef Q_OS_LINUX
+  // Subscribe to address and link changes
+  _socket = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+  if (_socket >= 0) {
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+    if (0 != bind(_socket, (struct sockaddr *)&addr, sizeof(addr))) {
+      logWarning() << "NetworkMonitor: Cannot bind netlink socket: " << strerror(errno);
+      close(_socket); _socket = -1;
+    }
+  }
+  if (_socket >= 0) {
+    _notifier = new QSocketNotifier(_socket, QSocketNotifier::Read, this);
+    connect(_notifier, SIGNAL(activated(int)), this, SLOT(_onNetlinkReadable()));
+    logDebug() << "NetworkMonitor: Watch network changes using netlink.";
+    return;
+  }
+#endif
+
+  // Fallback: poll addresses
+  _pollTimer.setInterval(NETMONITOR_POLL_INTERVAL);
+  _pollTimer.setSingleShot(false);
+  connect(&_pollTimer, SIGNAL(timeout()), this, SLOT(_onPoll()));
+  _pollTimer.start();
+}
+
+NetworkMonitor::~NetworkMonitor() {
+#ifdef Q_OS_LINUX
+  if (_socket >= 0) {
+    delete _notifier;
+    close(_socket);
+  }
+#endif
+}
+
+void
+NetworkMonitor::_onNetlinkReadable() {
+#ifdef Q_OS_LINUX
+  char buffer[8192];
+  bool relevant = false;
+  ssize_t len;
+  // Drain socket
+  while ((len = recv(_socket, buffer, sizeof(buffer), 0)) > 0) {
+    struct nlmsghdr *msg = (struct nlmsghdr *)buffer;
+    for (; NLMSG_OK(msg, len); msg = NLMSG_NEXT(msg, len)) {
+      switch (msg->nlmsg_type) {
+      case RTM_NEWADDR:
+      case RTM_DELADDR:
+      case RTM_NEWLINK:
+      case RTM_DELLINK:
+        relevant = true;
+        break;
+      default:
+        break;
+      }
+    }
+  }
+  if (relevant) {
+    _settleTimer.start();
+  }
+#endif
+}
+
+void
+NetworkMonitor::_onPoll() {
+  if (_addresses() != _known) {
+    _settleTimer.start();
+  }
+}
+
+void
+NetworkMonitor::_onSettled() {
+  // Only report actual changes of the addresses (e.g., not a link going up without address)
+  QSet<QString> current = _addresses();
+  if (current == _known) { return; }
+  _known = current;
+  logInfo() << "Network configuration changed.";
+  emit changed();
+}
+
+QSet<QString>
+NetworkMonitor::_addresses() {
+  QSet<QString> addresses;
+  foreach (QHostAddress addr, QNetworkInterface::allAddresses()) {
+    if (addr.isLoopback()) { continue; }
+    addresses.insert(addr.toString());
+  }
+  return addresses;
+}
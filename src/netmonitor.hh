@@ -0,0 +1,50 @@
+#ifndef NETMONITOR_H
+#define NETMONITOR_H
+
+#include <QObject>
+#include <QTimer>
+#include <QSet>
+#include <QString>
+
+class QSocketNotifier;
+
+
+/** Watches the network interfaces of the host for address changes (e.g., on roaming between
+ * WiFi networks). Under Linux the kernel notifies about changes through a netlink socket,
+ * on other systems the addresses are polled. Bursts of changes are reported once. */
+class NetworkMonitor : public QObject
+{
+  Q_OBJECT
+
+public:
+  /** Constructor. */
+  explicit NetworkMonitor(QObject *parent=0);
+  /** Destructor. */
+  virtual ~NetworkMonitor();
+
+signals:
+  /** Gets emitted if an address of an interface was added or removed. */
+  void changed();
+
+protected slots:
+  void _onNetlinkReadable();
+  void _onPoll();
+  void _onSettled();
+
+protected:
+  /** Returns the set of current (non-loopback) addresses. */
+  static QSet<QString> _addresses();
+
+protected:
+  /** The netlink socket or -1 if not available. */
+  int _socket;
+  QSocketNotifier *_notifier;
+  /** Polls the addresses if netlink is not available. */
+  QTimer _pollTimer;
+  /** Waits until a burst of changes settled. */
+  QTimer _settleTimer;
+  /** The known addresses. */
+  QSet<QString> _known;
+};
+
+#endif // NETMONITOR_H
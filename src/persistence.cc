@@ -0,0 +1,131 @@
+#include "persistence.hh"
+#include <ovlnet/logger.hh>
+#include <QCoreApplication>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QMutexLocker>
+
+
+/* ********************************************************************************************* *
+ * Implementation of Persistent
+ * ********************************************************************************************* */
+Persistent::~Persistent() {
+  // pass...
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of DeferredSave::State
+ * ********************************************************************************************* */
+DeferredSave::State::State(const QString &filename, DeferredSave *owner)
+  : lock(), filename(filename), written(0), owner(owner)
+{
+  // pass...
+}
+
+void
+DeferredSave::State::write(const QByteArray &data, quint64 version) {
+  QMutexLocker locker(&lock);
+  // Skip outdated versions
+  if (version <= written) { return; }
+
+  QSaveFile file(filename);
+  if (file.open(QIODevice::WriteOnly) && (data.size() == file.write(data)) && file.commit()) {
+    written = version;
+    return;
+  }
+  // Report error in the thread of the owner
+  QString error = file.errorString();
+  file.cancelWriting();
+  if (owner) {
+    QMetaObject::invokeMethod(owner, "_onSaveFailed", Qt::QueuedConnection,
+                              Q_ARG(QString, error));
+  }
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of DeferredSave::Task
+ * ********************************************************************************************* */
+class DeferredSave::Task: public QRunnable
+{
+public:
+  Task(const QSharedPointer<State> &state, const QByteArray &data, quint64 version)
+    : QRunnable(), _state(state), _data(data), _version(version)
+  {
+    // pass...
+  }
+
+  void run() {
+    _state->write(_data, _version);
+  }
+
+protected:
+  QSharedPointer<State> _state;
+  QByteArray _data;
+  quint64 _version;
+};
+
+
+/* ********************************************************************************************* *
+ * Implementation of DeferredSave
+ * ********************************************************************************************* */
+DeferredSave::DeferredSave(Persistent &object, const QString &filename, int delay, QObject *parent)
+  : QObject(parent), _object(object), _state(new State(filename, this)), _version(0),
+    _pending(false), _timer()
+{
+  _timer.setInterval(delay);
+  _timer.setSingleShot(true);
+  connect(&_timer, SIGNAL(timeout()), this, SLOT(_onSave()));
+  // Write pending changes before the application quits
+  if (QCoreApplication::instance()) {
+    connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()), this, SLOT(flush()));
+  }
+}
+
+DeferredSave::~DeferredSave() {
+  QMutexLocker locker(&_state->lock);
+  _state->owner = 0;
+}
+
+const QString &
+DeferredSave::fileName() const {
+  return _state->filename;
+}
+
+bool
+DeferredSave::isPending() const {
+  return _pending;
+}
+
+void
+DeferredSave::schedule() {
+  _pending = true;
+  // Do not restart a running timer, a save request is delayed at most by one interval.
+  if (! _timer.isActive()) {
+    _timer.start();
+  }
+}
+
+void
+DeferredSave::flush() {
+  if (! _pending) { return; }
+  _timer.stop();
+  _pending = false;
+  _state->write(_object.persistentData(), ++_version);
+}
+
+void
+DeferredSave::_onSave() {
+  if (! _pending) { return; }
+  _pending = false;
+  // Serialize here, write in the background
+  QThreadPool::globalInstance()->start(
+        new Task(_state, _object.persistentData(), ++_version));
+}
+
+void
+DeferredSave::_onSaveFailed(const QString &error) {
+  logError() << "Cannot save " << _state->filename << ": " << error;
+}
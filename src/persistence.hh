@@ -0,0 +1,90 @@
+#ifndef PERSISTENCE_H
+#define PERSISTENCE_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QTimer>
+#include <QMutex>
+#include <QSharedPointer>
+
+
+/** Interface of all objects that can be saved using a @c DeferredSave instance. */
+class Persistent
+{
+public:
+  /** Destructor. */
+  virtual ~Persistent();
+
+  /** Returns the serialized state of the object. This method gets called in the thread of the
+   * @c DeferredSave instance. */
+  virtual QByteArray persistentData() const = 0;
+};
+
+
+/** Saves a @c Persistent object into a file. All save requests within a short delay are
+ * coalesced into a single write. The file is written in a background thread into a temporary
+ * file which then replaces the old file, hence a crash never leaves a truncated file behind.
+ * Pending changes are written when the application quits. The owner must call @c flush in its
+ * destructor, as the object cannot be serialized once it is being torn down. */
+class DeferredSave : public QObject
+{
+  Q_OBJECT
+
+public:
+  /** Constructor.
+   * @param object Specifies the object to save.
+   * @param filename Specifies the file to save the object into.
+   * @param delay Specifies the delay in ms within which save requests are coalesced. */
+  DeferredSave(Persistent &object, const QString &filename, int delay=1000, QObject *parent=0);
+  /** Destructor, drops pending changes (see @c flush). */
+  virtual ~DeferredSave();
+
+  /** Returns the file name. */
+  const QString &fileName() const;
+  /** Returns @c true if there are changes not yet written. */
+  bool isPending() const;
+
+public slots:
+  /** Requests to save the object. */
+  void schedule();
+  /** Writes pending changes immediately (blocking). */
+  void flush();
+
+protected slots:
+  void _onSave();
+  void _onSaveFailed(const QString &error);
+
+protected:
+  /** The state shared with the background writer. */
+  class State
+  {
+  public:
+    State(const QString &filename, DeferredSave *owner);
+    /** Writes the data into the file unless a newer version has been written already. */
+    void write(const QByteArray &data, quint64 version);
+
+  public:
+    QMutex lock;
+    QString filename;
+    /** The version written last. */
+    quint64 written;
+    /** The owner, gets notified about errors. Set to 0 once the owner is destroyed. */
+    DeferredSave *owner;
+  };
+
+  /** Writes a serialized version of the object in a background thread. */
+  class Task;
+
+protected:
+  Persistent &_object;
+  QSharedPointer<State> _state;
+  /** The version of the last serialization. */
+  quint64 _version;
+  /** If @c true, there are changes not yet serialized. */
+  bool _pending;
+  /** Coalesces save requests. */
+  QTimer _timer;
+};
+
+#endif // PERSISTENCE_H
@@ -1,21 +1,140 @@
 #include "searchcompletion.hh"
+#include "application.hh"
+#include <QIcon>
+#include <algorithm>
 
-SearchCompletionModel::SearchCompletionModel(Node &dht, QObject *parent)
-  : QAbstractListModel(parent), _dht(dht), _results()
+// Maximum number of matches offered
+#define COMPLETION_MAX_MATCHES 20
+// Maximum age (ms) of the index, before the routing table is read again
+#define COMPLETION_MAX_AGE     (1000*30)
+// Maximum number of search results kept in the index
+#define COMPLETION_MAX_ADDED   1024
+
+
+SearchCompletionModel::SearchCompletionModel(Application &app, QObject *parent)
+  : QAbstractListModel(parent), _application(app), _index(), _added(), _outdated(true), _age(),
+    _matches()
 {
-  connect(&_dht, SIGNAL(nodeNotFound(Identifier,QList<NodeItem>)),
-          this, SLOT(_onNodeNotFound(Identifier,QList<NodeItem>)));
+  connect(&_application.buddies(), SIGNAL(rowsInserted(QModelIndex,int,int)),
+          this, SLOT(_invalidate()));
+  connect(&_application.buddies(), SIGNAL(rowsRemoved(QModelIndex,int,int)),
+          this, SLOT(_invalidate()));
+  connect(&_application.buddies(), SIGNAL(modelReset()), this, SLOT(_invalidate()));
+}
+
+void
+SearchCompletionModel::setPrefix(const QString &prefix) {
+  if (_outdated || (! _age.isValid()) || (_age.elapsed() > COMPLETION_MAX_AGE)) {
+    _rebuild();
+  }
+
+  beginResetModel();
+  _matches.clear();
+  if (! prefix.isEmpty()) {
+    Entry key; key.key = prefix.toLower();
+    QVector<Entry>::const_iterator entry =
+        std::lower_bound(_index.constBegin(), _index.constEnd(), key, _keyLessThan);
+    for (; (entry != _index.constEnd()) && entry->key.startsWith(key.key) &&
+         (_matches.size() < COMPLETION_MAX_MATCHES); entry++) {
+      _matches.append(*entry);
+    }
+  }
+  endResetModel();
 }
 
 void
-SearchCompletionModel::_onNodeNotFound(const Identifier &id, const QList<NodeItem> &best) {
-  _results = best;
+SearchCompletionModel::add(const Identifier &id) {
+  _append(_added, id, QString());
+  if (_added.size() > COMPLETION_MAX_ADDED) {
+    _added.remove(0, _added.size()-COMPLETION_MAX_ADDED);
+  }
+  _outdated = true;
+}
+
+Identifier
+SearchCompletionModel::identifier(int row) const {
+  if ((row < 0) || (row >= _matches.size())) { return Identifier(); }
+  return _matches[row].id;
 }
 
 int
 SearchCompletionModel::rowCount(const QModelIndex &parent) const {
-  return _results.size();
+  if (parent.isValid()) { return 0; }
+  return _matches.size();
 }
 
+QVariant
+SearchCompletionModel::data(const QModelIndex &index, int role) const {
+  if ((! index.isValid()) || (index.row() >= _matches.size())) { return QVariant(); }
+  const Entry &entry = _matches[index.row()];
+  if (Qt::EditRole == role) {
+    return entry.id.toBase32();
+  } else if (Qt::DisplayRole == role) {
+    if (entry.name.isEmpty()) { return entry.id.toBase32(); }
+    return tr("%1 (%2)").arg(entry.name).arg(entry.id.toBase32());
+  } else if (Qt::DecorationRole == role) {
+    if (! entry.name.isEmpty()) { return QIcon("://icons/person.png"); }
+  }
+  return QVariant();
+}
 
+void
+SearchCompletionModel::_invalidate() {
+  _outdated = true;
+}
 
+bool
+SearchCompletionModel::_lessThan(const Entry &a, const Entry &b) {
+  // Entries of buddies first among equal keys
+  if (a.key == b.key) { return a.name > b.name; }
+  return a.key < b.key;
+}
+
+bool
+SearchCompletionModel::_keyLessThan(const Entry &a, const Entry &b) {
+  return a.key < b.key;
+}
+
+bool
+SearchCompletionModel::_equal(const Entry &a, const Entry &b) {
+  return (a.key == b.key) && (a.id == b.id);
+}
+
+void
+SearchCompletionModel::_rebuild() {
+  QVector<Entry> entries = _added;
+  // Buddies by name and identifier of their nodes
+  BuddyList &buddies = _application.buddies();
+  for (size_t i=0; i<buddies.numBuddies(); i++) {
+    BuddyList::Buddy *buddy = buddies.getBuddy(i);
+    BuddyList::Buddy::const_iterator node = buddy->begin();
+    for (; node != buddy->end(); node++) {
+      _append(entries, (*node)->id(), buddy->name());
+    }
+  }
+  // Nodes of the routing table
+  QList<NodeItem> nodes; _application.dht().nodes(nodes);
+  QList<NodeItem>::iterator node = nodes.begin();
+  for (; node != nodes.end(); node++) {
+    _append(entries, node->id(), QString());
+  }
+  std::sort(entries.begin(), entries.end(), _lessThan);
+  entries.erase(std::unique(entries.begin(), entries.end(), _equal), entries.end());
+  _index = entries;
+  _outdated = false;
+  _age.start();
+}
+
+void
+SearchCompletionModel::_append(QVector<Entry> &entries, const Identifier &id,
+                               const QString &name)
+{
+  Entry entry;
+  entry.name = name; entry.id = id;
+  entry.key = id.toBase32().toLower();
+  entries.append(entry);
+  if (! name.isEmpty()) {
+    entry.key = name.toLower();
+    entries.append(entry);
+  }
+}
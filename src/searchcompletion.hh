@@ -2,26 +2,75 @@
 #define SEARCHCOMPLETION_H
 
 #include <QAbstractListModel>
+#include <QVector>
+#include <QElapsedTimer>
 #include <ovlnet/node.hh>
 
+// forward declarations
+class Application;
 
+
+/** Offers buddies and known nodes (routing table and search results) matching a prefix of
+ * their identifier or the name of the buddy. The candidates are kept in a sorted index, hence a
+ * prefix is found by binary search. The model only contains the matches of the current prefix,
+ * and is meant to be used with a @c QCompleter in @c UnfilteredPopupCompletion mode. */
 class SearchCompletionModel : public QAbstractListModel
 {
   Q_OBJECT
 
 public:
-  explicit SearchCompletionModel(Node &dht, QObject *parent = 0);
+  explicit SearchCompletionModel(Application &app, QObject *parent = 0);
+
+  /** Updates the matches for the given prefix. */
+  void setPrefix(const QString &prefix);
+  /** Adds a node (e.g., a search result) to the index. */
+  void add(const Identifier &id);
+
+  /** Returns the identifier of the given match. */
+  Identifier identifier(int row) const;
 
   int rowCount(const QModelIndex &parent) const;
+  QVariant data(const QModelIndex &index, int role) const;
 
 protected slots:
-  void _onNodeNotFound(const Identifier &id, const QList<NodeItem> &best);
+  /** Marks the index as outdated. */
+  void _invalidate();
+
+protected:
+  /** An entry of the index. */
+  typedef struct {
+    /** The lower-case key (identifier or buddy name). */
+    QString key;
+    /** The name of the buddy or empty. */
+    QString name;
+    /** The identifier of the node. */
+    Identifier id;
+  } Entry;
+
+  /** Orders entries by key, entries of buddies first. */
+  static bool _lessThan(const Entry &a, const Entry &b);
+  /** Orders entries by key only (for the prefix search). */
+  static bool _keyLessThan(const Entry &a, const Entry &b);
+  /** Returns @c true if both entries refer to the same node by the same key. */
+  static bool _equal(const Entry &a, const Entry &b);
+  /** Rebuilds the index from the buddy list and the routing table. */
+  void _rebuild();
+  /** Appends the entries of the given node to the list. */
+  static void _append(QVector<Entry> &entries, const Identifier &id, const QString &name);
 
 protected:
-  /** Weak reference to the DHT instance (for searching). */
-  Node &_dht;
-  /** Last search results. */
-  QList<NodeItem> _results;
+  /** Weak reference to the application. */
+  Application &_application;
+  /** The sorted index. */
+  QVector<Entry> _index;
+  /** Nodes added explicitly (kept on rebuild). */
+  QVector<Entry> _added;
+  /** If @c true, the index must be rebuilt before the next lookup. */
+  bool _outdated;
+  /** Age of the index (the routing table is not observed). */
+  QElapsedTimer _age;
+  /** The current matches. */
+  QVector<Entry> _matches;
 };
 
 #endif // SEARCHCOMPLETION_H
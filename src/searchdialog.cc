@@ -1,4 +1,5 @@
 #include "searchdialog.hh"
+#include "application.hh"
 #include <ovlnet/dht_config.hh>
 
 #include <QLabel>
@@ -10,14 +11,41 @@
 #include <QInputDialog>
 #include <QTableWidgetItem>
 #include <QCloseEvent>
+#include <QBrush>
 
 
-SearchDialog::SearchDialog(Node *dht, BuddyList *buddies, QWidget *parent)
-  : QWidget(parent), _dht(dht), _buddies(buddies)
+/* ********************************************************************************************* *
+ * Implementation of StreamingFindNodeQuery
+ * ********************************************************************************************* */
+StreamingFindNodeQuery::StreamingFindNodeQuery(const Identifier &id)
+  : FindNodeQuery(id)
+{
+  // pass...
+}
+
+void
+StreamingFindNodeQuery::update(const NodeItem &node) {
+  FindNodeQuery::update(node);
+  emit discovered(node);
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of SearchDialog
+ * ********************************************************************************************* */
+SearchDialog::SearchDialog(Application &app, QWidget *parent)
+  : QWidget(parent), _application(app), _dht(&app.dht()), _buddies(&app.buddies()), _rows()
 {
   setWindowTitle(tr("Overlay network node search"));
   setMinimumWidth(600);
   _query = new QLineEdit();
+  _query->setPlaceholderText(tr("Identifier or contact name"));
+
+  // Offer matching contacts and known nodes while typing
+  _completionModel = new SearchCompletionModel(app, this);
+  _completer = new QCompleter(_completionModel, this);
+  _completer->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+  _query->setCompleter(_completer);
 
   _result = new QTableWidget();
   _result->setColumnCount(3);
@@ -38,6 +66,7 @@ SearchDialog::SearchDialog(Node *dht, BuddyList *buddies, QWidget *parent)
   setLayout(layout);
 
   QObject::connect(_query, SIGNAL(returnPressed()), this, SLOT(_onStartSearch()));
+  QObject::connect(_query, SIGNAL(textEdited(QString)), this, SLOT(_onTextEdited(QString)));
   QObject::connect(addAsNew, SIGNAL(clicked()), this, SLOT(_onAddAsNewBuddy()));
   QObject::connect(addTo, SIGNAL(clicked()), this, SLOT(_onAddToBuddy()));
 }
@@ -46,14 +75,21 @@ void
 SearchDialog::_onStartSearch() {
   // Assemble ID
   Identifier id = Identifier::fromBase32(_query->text());
+  if ((OVL_HASH_SIZE != id.size()) && (1 == _completionModel->rowCount(QModelIndex()))) {
+    // Take the only match of a partial identifier or a contact name
+    id = _completionModel->identifier(0);
+    _query->setText(id.toBase32());
+  }
+  if (OVL_HASH_SIZE != id.size()) { return; }
   _currentSearch = id;
   _result->setRowCount(0);
-  FindNodeQuery *query = new FindNodeQuery(_currentSearch);
+  _rows.clear();
+  StreamingFindNodeQuery *query = new StreamingFindNodeQuery(_currentSearch);
+  QObject::connect(query, SIGNAL(discovered(NodeItem)), this, SLOT(_onNodeDiscovered(NodeItem)));
   QObject::connect(query, SIGNAL(found(NodeItem)), this, SLOT(_onSearchSuccess(NodeItem)));
   QObject::connect(query, SIGNAL(failed(Identifier,QList<NodeItem>)),
                    this, SLOT(_onSearchFailed(Identifier,QList<NodeItem>)));
-  _dht->search(query);
-
+  _application.lookups().search(query, Metrics::LOOKUP_SEARCH);
 }
 
 void
@@ -80,17 +116,22 @@ SearchDialog::_onAddToBuddy() {
 
 }
 
+void
+SearchDialog::_onTextEdited(const QString &text) {
+  _completionModel->setPrefix(text);
+}
+
+void
+SearchDialog::_onNodeDiscovered(const NodeItem &node) {
+  StreamingFindNodeQuery *query = qobject_cast<StreamingFindNodeQuery *>(sender());
+  if ((0 == query) || (query->id() != _currentSearch)) { return; }
+  _showNode(node, false);
+}
+
 void
 SearchDialog::_onSearchSuccess(const NodeItem &node) {
   if (node.id() != _currentSearch) { return; }
-  // Exclude myself from the results
-  if (node.id() == _dht->id()) { return; }
-  // Append a row with the results
-  size_t idx = _result->rowCount();
-  _result->setRowCount(idx+1);
-  _result->setItem(idx, 0, new QTableWidgetItem(node.id().toBase32()));
-  _result->setItem(idx, 1, new QTableWidgetItem(node.addr().toString()));
-  _result->setItem(idx, 2, new QTableWidgetItem(QString::number(node.port())));
+  _showNode(node, true);
 }
 
 void
@@ -98,13 +139,29 @@ SearchDialog::_onSearchFailed(const Identifier &id, const QList<NodeItem> &best)
   if (id != _currentSearch) { return; }
   QList<NodeItem>::const_iterator node = best.begin();
   for (; node != best.end(); node++) {
-    // Exclude myself from list
-    if (node->id() == _dht->id()) { continue; }
-    // Append a row with the results
-    size_t idx = _result->rowCount(); _result->setRowCount(idx+1);
-    _result->setItem(idx, 0, new QTableWidgetItem(node->id().toBase32()));
-    _result->setItem(idx, 1, new QTableWidgetItem(node->addr().toString()));
-    _result->setItem(idx, 2, new QTableWidgetItem(QString::number(node->port())));
+    _showNode(*node, true);
+  }
+}
+
+void
+SearchDialog::_showNode(const NodeItem &node, bool result) {
+  // Exclude myself from the results
+  if (node.id() == _dht->id()) { return; }
+  int idx = _rows.value(node.id(), -1);
+  // Nodes seen again during the search are not updated
+  if ((idx >= 0) && (! result)) { return; }
+  if (idx < 0) {
+    // Append a row
+    idx = _result->rowCount(); _result->setRowCount(idx+1);
+    _rows.insert(node.id(), idx);
+    _completionModel->add(node.id());
+  }
+  _result->setItem(idx, 0, new QTableWidgetItem(node.id().toBase32()));
+  _result->setItem(idx, 1, new QTableWidgetItem(node.addr().toString()));
+  _result->setItem(idx, 2, new QTableWidgetItem(QString::number(node.port())));
+  QBrush color = result ? QBrush(Qt::black) : QBrush(Qt::gray);
+  for (int i=0; i<3; i++) {
+    _result->item(idx, i)->setForeground(color);
   }
 }
 
@@ -3,20 +3,44 @@
 
 #include <ovlnet/node.hh>
 #include "buddylist.hh"
+#include "searchcompletion.hh"
 
 #include <QWidget>
 #include <QLineEdit>
 #include <QTableWidget>
+#include <QCompleter>
+
+class Application;
+
+
+/** A node lookup, that reports every node learned during the iterative search. */
+class StreamingFindNodeQuery: public FindNodeQuery
+{
+  Q_OBJECT
+
+public:
+  explicit StreamingFindNodeQuery(const Identifier &id);
+
+  /** Gets called by the node for each node learned during the search. */
+  virtual void update(const NodeItem &node);
+
+signals:
+  /** Gets emitted for each node learned during the search. */
+  void discovered(const NodeItem &node);
+};
+
 
 class SearchDialog : public QWidget
 {
   Q_OBJECT
 
 public:
-  explicit SearchDialog(Node *dht, BuddyList *buddies, QWidget *parent = 0);
+  explicit SearchDialog(Application &app, QWidget *parent = 0);
 
 protected slots:
   void _onStartSearch();
+  void _onTextEdited(const QString &text);
+  void _onNodeDiscovered(const NodeItem &node);
   void _onSearchSuccess(const NodeItem &node);
   void _onSearchFailed(const Identifier &id, const QList<NodeItem> &best);
   void _onAddAsNewBuddy();
@@ -24,13 +48,22 @@ protected slots:
 
 protected:
   void closeEvent(QCloseEvent *evt);
+  /** Adds or updates the row of the given node. Nodes discovered during the search are shown
+   * grayed out until they are part of the result. */
+  void _showNode(const NodeItem &node, bool result);
 
 protected:
+  Application &_application;
   Node *_dht;
   BuddyList *_buddies;
   Identifier _currentSearch;
   QLineEdit *_query;
   QTableWidget *_result;
+  /** Row of each node shown. */
+  QHash<Identifier, int> _rows;
+  /** Offers buddies and known nodes while typing. */
+  SearchCompletionModel *_completionModel;
+  QCompleter *_completer;
 };
 
 #endif // SEARCHDIALOG_H
@@ -1,6 +1,8 @@
 #include "settings.hh"
 #include <ovlnet/logger.hh>
+#include <ovlnet/dht_config.hh>
 #include <QJsonArray>
+#include <algorithm>
 
 
 /* ********************************************************************************************* *
@@ -21,37 +23,51 @@ SubSetting::~SubSetting() {
  * Implementation of Settings
  * ********************************************************************************************* */
 Settings::Settings(const QString &filename, QObject *parent)
-  : QObject(parent), _file(filename), _socksServiceSettings(0), _upnpSettings(0)
+  : QObject(parent), Persistent(), _writer(*this, filename), _socksServiceSettings(0),
+    _upnpSettings(0), _metricsSettings(0), _fileTransferSettings(0)
 {
-  if (!_file.open(QIODevice::ReadOnly)) { return; }
-  logDebug() << "Settings: Load client settings from " << filename;
-  QJsonDocument doc = QJsonDocument::fromJson(_file.readAll());
-  _file.close();
-
-  if (! doc.isObject())
-    return;
+  QJsonObject obj;
+  QFile file(filename);
+  if (file.open(QIODevice::ReadOnly)) {
+    logDebug() << "Settings: Load client settings from " << filename;
+    QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+    file.close();
+    if (doc.isObject()) { obj = doc.object(); }
+  }
 
-  // Socks service settings
-  _socksServiceSettings = new SocksServiceSettings(doc.object().value("socks_service"), this);
+  // Socks service settings (missing settings are initialized with the defaults)
+  _socksServiceSettings = new SocksServiceSettings(obj.value("socks_service"), this);
   connect(_socksServiceSettings, SIGNAL(modified()), this, SLOT(save()));
   // UPNP settings
-  _upnpSettings = new UPNPSettings(doc.object().value("upnp"), this);
+  _upnpSettings = new UPNPSettings(obj.value("upnp"), this);
   connect(_upnpSettings, SIGNAL(modified()), this, SLOT(save()));
+  // Metrics exporter settings
+  _metricsSettings = new MetricsSettings(obj.value("metrics"), this);
+  connect(_metricsSettings, SIGNAL(modified()), this, SLOT(save()));
+  // File transfer settings
+  _fileTransferSettings = new FileTransferSettings(obj.value("file_transfer"), this);
+  connect(_fileTransferSettings, SIGNAL(modified()), this, SLOT(save()));
+}
+
+Settings::~Settings() {
+  // Write pending changes while the sub-settings still exist
+  _writer.flush();
 }
 
 void
 Settings::save() {
-  if (! _file.open(QIODevice::WriteOnly)) {
-    logWarning() << "Settings: Cannot save settings to " << _file.fileName()
-                 << ": " << _file.errorString();
-    return;
-  }
+  _writer.schedule();
+}
 
+QByteArray
+Settings::persistentData() const {
   QJsonObject obj;
   obj.insert("socks_service", _socksServiceSettings->serialize());
+  obj.insert("upnp", _upnpSettings->serialize());
+  obj.insert("metrics", _metricsSettings->serialize());
+  obj.insert("file_transfer", _fileTransferSettings->serialize());
   QJsonDocument doc(obj);
-  _file.write(doc.toJson());
-  _file.close();
+  return doc.toJson();
 }
 
 SocksServiceSettings &
@@ -64,6 +80,16 @@ Settings::upnpSettings() {
   return *_upnpSettings;
 }
 
+MetricsSettings &
+Settings::metricsSettings() {
+  return *_metricsSettings;
+}
+
+FileTransferSettings &
+Settings::fileTransferSettings() {
+  return *_fileTransferSettings;
+}
+
 
 /* ********************************************************************************************* *
  * Implementation of SocksServiceSettings
@@ -72,9 +98,6 @@ SocksServiceSettings::SocksServiceSettings(const QJsonValue &value, QObject *par
   : SubSetting(value, parent), _enabled(false), _allowBuddies(false), _allowWhitelist(false),
     _whitelist(0)
 {
-  if (! value.isObject())
-    return;
-
   QJsonObject object = value.toObject();
   // Get settings
   _enabled = object.value("enabled").toBool(false);
@@ -187,6 +210,116 @@ UPNPSettings::serialize() const {
 }
 
 
+/* ********************************************************************************************* *
+ * Implementation of MetricsSettings
+ * ********************************************************************************************* */
+MetricsSettings::MetricsSettings(const QJsonValue &value, QObject *parent)
+  : SubSetting(value, parent), _enabled(false), _port(9742)
+{
+  if (! value.isObject())
+    return;
+  QJsonObject obj = value.toObject();
+  if (obj.contains("enabled"))
+    _enabled = obj.value("enabled").toBool(_enabled);
+  if (obj.contains("port"))
+    _port = obj.value("port").toInt(_port);
+}
+
+bool
+MetricsSettings::enabled() const {
+  return _enabled;
+}
+
+void
+MetricsSettings::enable(bool enabled) {
+  if (_enabled == enabled)
+    return;
+  _enabled = enabled;
+  emit modified();
+}
+
+uint16_t
+MetricsSettings::port() const {
+  return _port;
+}
+
+void
+MetricsSettings::setPort(uint16_t port) {
+  if (_port == port)
+    return;
+  _port = port;
+  emit modified();
+}
+
+void
+MetricsSettings::set(bool enabled, uint16_t port) {
+  if ((_enabled == enabled) && (_port == port))
+    return;
+  _enabled = enabled;
+  _port = port;
+  emit modified();
+}
+
+QJsonValue
+MetricsSettings::serialize() const {
+  QJsonObject obj;
+  obj.insert("enabled", _enabled);
+  obj.insert("port", _port);
+  return obj;
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of FileTransferSettings
+ * ********************************************************************************************* */
+FileTransferSettings::FileTransferSettings(const QJsonValue &value, QObject *parent)
+  : SubSetting(value, parent), _compress(true), _maxActive(3)
+{
+  if (! value.isObject())
+    return;
+  QJsonObject obj = value.toObject();
+  if (obj.contains("compress"))
+    _compress = obj.value("compress").toBool(_compress);
+  if (obj.contains("max_active"))
+    _maxActive = std::max(1, obj.value("max_active").toInt(_maxActive));
+}
+
+bool
+FileTransferSettings::compress() const {
+  return _compress;
+}
+
+void
+FileTransferSettings::setCompress(bool enabled) {
+  if (_compress == enabled)
+    return;
+  _compress = enabled;
+  emit modified();
+}
+
+int
+FileTransferSettings::maxActive() const {
+  return _maxActive;
+}
+
+void
+FileTransferSettings::setMaxActive(int count) {
+  count = std::max(1, count);
+  if (_maxActive == count)
+    return;
+  _maxActive = count;
+  emit modified();
+}
+
+QJsonValue
+FileTransferSettings::serialize() const {
+  QJsonObject obj;
+  obj.insert("compress", _compress);
+  obj.insert("max_active", _maxActive);
+  return obj;
+}
+
+
 /* ********************************************************************************************* *
  * Implementation of SocksServiceWhiteList
  * ********************************************************************************************* */
@@ -198,9 +331,14 @@ NodeIdList::NodeIdList(const QJsonValue &value, QObject *parent)
 
   QJsonArray lst = value.toArray();
   for (QJsonArray::const_iterator item = lst.begin(); item != lst.end(); item++) {
-    if ((*item).isString()) {
-      _list.insert(Identifier::fromBase32((*item).toString()));
+    if (! (*item).isString()) { continue; }
+    // Validate identifiers once while loading
+    Identifier id = Identifier::fromBase32((*item).toString());
+    if (OVL_HASH_SIZE != id.size()) {
+      logWarning() << "Settings: Skip invalid node identifier " << (*item).toString();
+      continue;
     }
+    _list.insert(id);
   }
 }
 
@@ -8,6 +8,7 @@
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <ovlnet/buckets.hh>
+#include "persistence.hh"
 
 
 class SubSetting: public QObject
@@ -106,32 +107,95 @@ protected:
 };
 
 
+/** Holds the settings of the metrics exporter. */
+class MetricsSettings: public SubSetting
+{
+  Q_OBJECT
+
+public:
+  MetricsSettings(const QJsonValue &value, QObject *parent=0);
+
+  bool enabled() const;
+  void enable(bool enabled);
+
+  /** The local port, the metrics are served at. */
+  uint16_t port() const;
+  void setPort(uint16_t port);
+  /** Updates both settings at once, emits @c modified only once. */
+  void set(bool enabled, uint16_t port);
+
+  QJsonValue serialize() const;
+
+protected:
+  bool _enabled;
+  uint16_t _port;
+};
+
+
+/** Holds the settings of file transfers. */
+class FileTransferSettings: public SubSetting
+{
+  Q_OBJECT
+
+public:
+  FileTransferSettings(const QJsonValue &value, QObject *parent=0);
+
+  /** If @c true, compressible files are sent compressed. */
+  bool compress() const;
+  void setCompress(bool enabled);
+
+  /** The maximum number of uploads running at once, further uploads are queued. */
+  int maxActive() const;
+  void setMaxActive(int count);
+
+  QJsonValue serialize() const;
+
+protected:
+  bool _compress;
+  int _maxActive;
+};
+
+
 /** Implements a persistent settings object, collecting the options of several modules and
  * services and keep them in a single file. */
-class Settings : public QObject
+class Settings : public QObject, public Persistent
 {
   Q_OBJECT
 
 public:
   /** Loads the settings from the given file (or initializes them with the default ones). */
   explicit Settings(const QString &filename, QObject *parent = 0);
+  /** Destructor, writes pending changes. */
+  virtual ~Settings();
 
   /** Returns a weak reference to the socks service settings. */
   SocksServiceSettings &socksServiceSettings();
   /** Returns a weak reference to the UPNP settings. */
   UPNPSettings &upnpSettings();
+  /** Returns a weak reference to the metrics exporter settings. */
+  MetricsSettings &metricsSettings();
+  /** Returns a weak reference to the file transfer settings. */
+  FileTransferSettings &fileTransferSettings();
+
+  /** Serializes the settings. */
+  QByteArray persistentData() const;
 
 public slots:
-  /** Save the current settings into the file give to the constructor. */
+  /** Save the current settings into the file give to the constructor. Several modifications
+   * within a short time are written at once. */
   void save();
 
 protected:
-  /** The settings file. */
-  QFile _file;
+  /** Writes the settings file. */
+  DeferredSave _writer;
   /** Settings for the socks proxy service. */
   SocksServiceSettings *_socksServiceSettings;
   /** Settings for the UPNP service. */
   UPNPSettings *_upnpSettings;
+  /** Settings for the metrics exporter. */
+  MetricsSettings *_metricsSettings;
+  /** Settings for file transfers. */
+  FileTransferSettings *_fileTransferSettings;
 };
 
 #endif // SETTINGS_H
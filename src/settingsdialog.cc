@@ -18,10 +18,14 @@ SettingsDialog::SettingsDialog(Settings &settings, QWidget *parent)
 
   _socks = new SocksServiceSettingsView(settings.socksServiceSettings());
   _upnp  = new UPNPSettingsView(settings.upnpSettings());
+  _metrics = new MetricsSettingsView(settings.metricsSettings());
+  _fileTransfer = new FileTransferSettingsView(settings.fileTransferSettings());
 
   QTabWidget *tabs = new QTabWidget();
   tabs->addTab(_socks, QIcon("://icons/globe.png"), tr("SOCKS5 Proxy"));
   tabs->addTab(_upnp, tr("UPNP"));
+  tabs->addTab(_metrics, QIcon("://icons/dashboard.png"), tr("Metrics"));
+  tabs->addTab(_fileTransfer, QIcon("://icons/data-transfer-upload.png"), tr("File transfer"));
 
   QDialogButtonBox *bbox = new QDialogButtonBox(
         QDialogButtonBox::Close | QDialogButtonBox::Apply | QDialogButtonBox::Ok);
@@ -40,6 +44,8 @@ void
 SettingsDialog::apply() {
   _socks->apply();
   _upnp->apply();
+  _metrics->apply();
+  _fileTransfer->apply();
   _settings.save();
 }
 
@@ -128,6 +134,71 @@ UPNPSettingsView::apply() {
 }
 
 
+/* ********************************************************************************************* *
+ * Implementation of MetricsSettingsView
+ * ********************************************************************************************* */
+MetricsSettingsView::MetricsSettingsView(MetricsSettings &settings, QWidget *parent)
+  : QWidget(parent), _settings(settings)
+{
+  _enabled = new QCheckBox();
+  _enabled->setChecked(_settings.enabled());
+  _port = new QLineEdit(QString::number(_settings.port()));
+  _port->setValidator(new QIntValidator(1, 0xffff));
+
+  QVBoxLayout *layout = new QVBoxLayout();
+  QFormLayout *form = new QFormLayout();
+  form->addRow(tr("Enabled"), _enabled);
+  form->addRow(tr("Local port"), _port);
+  layout->addLayout(form);
+  layout->addWidget(new QLabel(tr("Serves the metrics at http://localhost:<port>/metrics "
+                                  "in the OpenMetrics text format.")));
+  layout->addStretch(1);
+  setLayout(layout);
+}
+
+void
+MetricsSettingsView::apply() {
+  // Keep the current port if the field is empty or invalid
+  bool ok; uint port = _port->text().toUInt(&ok);
+  if ((! ok) || (0 == port) || (port > 0xffff)) {
+    port = _settings.port();
+    _port->setText(QString::number(port));
+  }
+  // Apply both at once, the exporter restarts on every modification
+  _settings.set(_enabled->isChecked(), port);
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of FileTransferSettingsView
+ * ********************************************************************************************* */
+FileTransferSettingsView::FileTransferSettingsView(FileTransferSettings &settings, QWidget *parent)
+  : QWidget(parent), _settings(settings)
+{
+  _compress = new QCheckBox();
+  _compress->setChecked(_settings.compress());
+  _maxActive = new QSpinBox();
+  _maxActive->setRange(1, 32);
+  _maxActive->setValue(_settings.maxActive());
+
+  QVBoxLayout *layout = new QVBoxLayout();
+  QFormLayout *form = new QFormLayout();
+  form->addRow(tr("Compress"), _compress);
+  form->addRow(tr("Concurrent uploads"), _maxActive);
+  layout->addLayout(form);
+  layout->addWidget(new QLabel(tr("Compresses files while sending them. Already compressed "
+                                  "data (e.g., images or archives) is sent as it is.")));
+  layout->addStretch(1);
+  setLayout(layout);
+}
+
+void
+FileTransferSettingsView::apply() {
+  _settings.setCompress(_compress->isChecked());
+  _settings.setMaxActive(_maxActive->value());
+}
+
+
 
 
 /* ********************************************************************************************* *
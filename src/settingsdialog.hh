@@ -4,6 +4,7 @@
 #include <QDialog>
 #include <QCheckBox>
 #include <QListWidget>
+#include <QSpinBox>
 #include "settings.hh"
 
 
@@ -64,6 +65,40 @@ protected:
 };
 
 
+class MetricsSettingsView: public QWidget
+{
+  Q_OBJECT
+
+public:
+  MetricsSettingsView(MetricsSettings &settings, QWidget *parent=0);
+
+public slots:
+  void apply();
+
+protected:
+  MetricsSettings &_settings;
+  QCheckBox *_enabled;
+  QLineEdit *_port;
+};
+
+
+class FileTransferSettingsView: public QWidget
+{
+  Q_OBJECT
+
+public:
+  FileTransferSettingsView(FileTransferSettings &settings, QWidget *parent=0);
+
+public slots:
+  void apply();
+
+protected:
+  FileTransferSettings &_settings;
+  QCheckBox *_compress;
+  QSpinBox *_maxActive;
+};
+
+
 class SettingsDialog : public QDialog
 {
   Q_OBJECT
@@ -78,6 +113,8 @@ protected:
   Settings &_settings;
   SocksServiceSettingsView *_socks;
   UPNPSettingsView *_upnp;
+  MetricsSettingsView *_metrics;
+  FileTransferSettingsView *_fileTransfer;
 };
 
 #endif // SETTINGSDIALOG_H
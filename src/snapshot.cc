@@ -0,0 +1,212 @@
+#include "snapshot.hh"
+#include "application.hh"
+#include <ovlnet/dht_config.hh>
+#include <ovlnet/logger.hh>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QFile>
+#include <QtEndian>
+#include <QVector>
+#include <QPair>
+#include <cstring>
+#include <algorithm>
+
+#define SNAPSHOT_MAGIC        "OVLS"
+#define SNAPSHOT_VERSION      1
+#define SNAPSHOT_HEADER_SIZE  24
+#define SNAPSHOT_RECORD_SIZE  (OVL_HASH_SIZE+28)
+// Maximum number of routing table peers stored
+#define SNAPSHOT_MAX_PEERS    64
+// Maximum time (s) since a peer responded last to be stored
+#define SNAPSHOT_MAX_PEER_AGE (60*60)
+// Interval (ms) of periodic updates
+#define SNAPSHOT_INTERVAL     (1000*60*5)
+
+
+/* Serializes a single node record. */
+static void
+writeRecord(QByteArray &buffer, const Identifier &id, const QHostAddress &addr, uint16_t port,
+            qint64 lastSeen)
+{
+  uchar record[SNAPSHOT_RECORD_SIZE];
+  memset(record, 0, SNAPSHOT_RECORD_SIZE);
+  memcpy(record, id.constData(), OVL_HASH_SIZE);
+  uchar *ptr = record + OVL_HASH_SIZE;
+  if (QAbstractSocket::IPv4Protocol == addr.protocol()) {
+    // Store IPv4 addresses as v4-mapped IPv6 addresses
+    ptr[10] = ptr[11] = 0xff;
+    qToBigEndian<quint32>(addr.toIPv4Address(), ptr+12);
+  } else {
+    Q_IPV6ADDR addr6 = addr.toIPv6Address();
+    memcpy(ptr, addr6.c, 16);
+  }
+  qToLittleEndian<quint16>(port, ptr+16);
+  qToLittleEndian<quint64>(lastSeen, ptr+20);
+  buffer.append((const char *)record, SNAPSHOT_RECORD_SIZE);
+}
+
+/* Reads the address from a node record. */
+static QHostAddress
+readAddress(const uchar *record) {
+  const uchar *ptr = record + OVL_HASH_SIZE;
+  static const uchar prefix[12] = {0,0,0,0, 0,0,0,0, 0,0,0xff,0xff};
+  if (0 == memcmp(ptr, prefix, 12)) {
+    return QHostAddress(qFromBigEndian<quint32>(ptr+12));
+  }
+  Q_IPV6ADDR addr6;
+  memcpy(addr6.c, ptr, 16);
+  return QHostAddress(addr6);
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of Snapshot
+ * ********************************************************************************************* */
+Snapshot::Snapshot(Application &app, const QString &filename, QObject *parent)
+  : QObject(parent), Persistent(), _application(app), _writer(*this, filename), _saveTimer(),
+    _buddyNodes(), _lastSeen()
+{
+  _saveTimer.setInterval(SNAPSHOT_INTERVAL);
+  _saveTimer.setSingleShot(false);
+  connect(&_saveTimer, SIGNAL(timeout()), this, SLOT(save()));
+  connect(&_application.dht(), SIGNAL(nodeReachable(NodeItem)),
+          this, SLOT(_onNodeReachable(NodeItem)));
+  _saveTimer.start();
+  // Write a final snapshot at shutdown
+  if (QCoreApplication::instance()) {
+    connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()), this, SLOT(_onQuit()));
+  }
+}
+
+Snapshot::~Snapshot() {
+  // Write pending changes before anything gets torn down
+  _writer.flush();
+}
+
+bool
+Snapshot::restore() {
+  QFile file(_writer.fileName());
+  if (! file.open(QIODevice::ReadOnly)) { return false; }
+  qint64 size = file.size();
+  if (size < SNAPSHOT_HEADER_SIZE) { return false; }
+  const uchar *data = file.map(0, size);
+  if (0 == data) {
+    logWarning() << "Snapshot: Cannot map " << file.fileName() << ": " << file.errorString();
+    return false;
+  }
+
+  // Check header
+  if ((0 != memcmp(data, SNAPSHOT_MAGIC, 4)) ||
+      (SNAPSHOT_VERSION != qFromLittleEndian<quint16>(data+4))) {
+    logWarning() << "Snapshot: Unknown format of " << file.fileName() << ", ignored.";
+    return false;
+  }
+  quint32 numBuddyNodes = qFromLittleEndian<quint32>(data+16);
+  quint32 numPeers = qFromLittleEndian<quint32>(data+20);
+  // Sum the counts in 64 bit, a corrupt header must not wrap around
+  qint64 numRecords = qint64(numBuddyNodes) + qint64(numPeers);
+  if ((numRecords > (size-SNAPSHOT_HEADER_SIZE)/SNAPSHOT_RECORD_SIZE) ||
+      (size != SNAPSHOT_HEADER_SIZE + numRecords*SNAPSHOT_RECORD_SIZE)) {
+    logWarning() << "Snapshot: Malformed file " << file.fileName() << ", ignored.";
+    return false;
+  }
+
+  // Contact buddy nodes at their last known endpoint, they appear as soon as they respond
+  const uchar *record = data + SNAPSHOT_HEADER_SIZE;
+  for (quint32 i=0; i<numBuddyNodes; i++, record += SNAPSHOT_RECORD_SIZE) {
+    Identifier id(QByteArray((const char *)record, OVL_HASH_SIZE));
+    if (! _application.buddies().hasNode(id)) { continue; }
+    Endpoint endpoint;
+    endpoint.addr = readAddress(record);
+    endpoint.port = qFromLittleEndian<quint16>(record+OVL_HASH_SIZE+16);
+    endpoint.lastSeen = qFromLittleEndian<quint64>(record+OVL_HASH_SIZE+20);
+    _buddyNodes.insert(id, endpoint);
+    _application.dht().ping(endpoint.addr, endpoint.port);
+  }
+  // Contact peers to seed the routing table, keep the time they were seen last
+  for (quint32 i=0; i<numPeers; i++, record += SNAPSHOT_RECORD_SIZE) {
+    Identifier id(QByteArray((const char *)record, OVL_HASH_SIZE));
+    _lastSeen.insert(id, qFromLittleEndian<quint64>(record+OVL_HASH_SIZE+20));
+    _application.dht().ping(readAddress(record),
+                            qFromLittleEndian<quint16>(record+OVL_HASH_SIZE+16));
+  }
+
+  logDebug() << "Snapshot: Restored " << numBuddyNodes << " buddy nodes and "
+             << numPeers << " peers from " << file.fileName();
+  return true;
+}
+
+QByteArray
+Snapshot::persistentData() const {
+  QByteArray buddyNodes, peers;
+  quint32 numBuddyNodes = 0, numPeers = 0;
+
+  // Collect buddy nodes, seen during this session or restored from the last snapshot
+  BuddyList &buddies = _application.buddies();
+  for (size_t i=0; i<buddies.numBuddies(); i++) {
+    BuddyList::Buddy::const_iterator node = buddies.getBuddy(i)->begin();
+    for (; node != buddies.getBuddy(i)->end(); node++) {
+      if ((*node)->hasBeenSeen()) {
+        writeRecord(buddyNodes, (*node)->id(), (*node)->addr(), (*node)->port(),
+                    (*node)->lastSeen().toMSecsSinceEpoch()/1000);
+      } else if (_buddyNodes.contains((*node)->id())) {
+        const Endpoint &endpoint = _buddyNodes[(*node)->id()];
+        writeRecord(buddyNodes, (*node)->id(), endpoint.addr, endpoint.port,
+                    endpoint.lastSeen);
+      } else {
+        continue;
+      }
+      numBuddyNodes++;
+    }
+  }
+
+  // Collect peers of the routing table that responded recently, most recent first
+  qint64 now = QDateTime::currentMSecsSinceEpoch()/1000;
+  QList<NodeItem> nodes; _application.dht().nodes(nodes);
+  QVector< QPair<qint64, int> > ranked;
+  for (int i=0; i<nodes.size(); i++) {
+    qint64 seen = _lastSeen.value(nodes[i].id(), 0);
+    if ((now - seen) <= SNAPSHOT_MAX_PEER_AGE) { ranked.append(qMakePair(seen, i)); }
+  }
+  std::sort(ranked.begin(), ranked.end());
+  for (int i=ranked.size()-1; (i>=0) && (numPeers < SNAPSHOT_MAX_PEERS); i--, numPeers++) {
+    const NodeItem &node = nodes[ranked[i].second];
+    writeRecord(peers, node.id(), node.addr(), node.port(), ranked[i].first);
+  }
+
+  // Assemble file
+  uchar header[SNAPSHOT_HEADER_SIZE];
+  memset(header, 0, SNAPSHOT_HEADER_SIZE);
+  memcpy(header, SNAPSHOT_MAGIC, 4);
+  qToLittleEndian<quint16>(SNAPSHOT_VERSION, header+4);
+  qToLittleEndian<quint64>(now, header+8);
+  qToLittleEndian<quint32>(numBuddyNodes, header+16);
+  qToLittleEndian<quint32>(numPeers, header+20);
+  QByteArray data((const char *)header, SNAPSHOT_HEADER_SIZE);
+  data.append(buddyNodes);
+  data.append(peers);
+  return data;
+}
+
+void
+Snapshot::save() {
+  // Forget nodes that did not respond for too long
+  qint64 now = QDateTime::currentMSecsSinceEpoch()/1000;
+  QHash<Identifier, qint64>::iterator item = _lastSeen.begin();
+  while (item != _lastSeen.end()) {
+    if ((now - item.value()) > SNAPSHOT_MAX_PEER_AGE) { item = _lastSeen.erase(item); }
+    else { item++; }
+  }
+  _writer.schedule();
+}
+
+void
+Snapshot::_onNodeReachable(const NodeItem &node) {
+  _lastSeen[node.id()] = QDateTime::currentMSecsSinceEpoch()/1000;
+}
+
+void
+Snapshot::_onQuit() {
+  _writer.schedule();
+  _writer.flush();
+}
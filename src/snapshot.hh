@@ -0,0 +1,75 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <QObject>
+#include <QHash>
+#include <QTimer>
+#include <ovlnet/node.hh>
+#include "persistence.hh"
+
+class Application;
+
+
+/** Keeps a binary snapshot of the last known addresses of buddy nodes and of some good
+ * peers of the routing table. The snapshot gets written periodically and at shutdown. At
+ * startup it is used to contact these nodes immediately instead of waiting for bootstrap and
+ * presence updates.
+ *
+ * The file format is versioned and consists of fixed-size little-endian records, hence it can
+ * be read directly from a memory mapped file:
+ * @code
+ * header: magic "OVLS" | version (u16) | reserved (u16) | time (u64) |
+ *         #buddy nodes (u32) | #peers (u32)
+ * record: id (OVL_HASH_SIZE bytes) | IPv6 or v4-mapped address (16 bytes) | port (u16) |
+ *         reserved (u16) | last seen (u64)
+ * @endcode */
+class Snapshot : public QObject, public Persistent
+{
+  Q_OBJECT
+
+public:
+  /** Constructor.
+   * @param app The application instance.
+   * @param filename Specifies the snapshot file. */
+  Snapshot(Application &app, const QString &filename, QObject *parent=0);
+  /** Destructor, writes pending changes. */
+  virtual ~Snapshot();
+
+  /** Reads the snapshot file and contacts the buddy nodes and peers stored in it. Returns
+   * @c false if there is no valid snapshot. */
+  bool restore();
+
+  /** Serializes the snapshot. */
+  QByteArray persistentData() const;
+
+public slots:
+  /** Requests to update the snapshot file. */
+  void save();
+
+protected slots:
+  void _onQuit();
+  /** Records the time a node responded. */
+  void _onNodeReachable(const NodeItem &node);
+
+protected:
+  /** A node endpoint stored in the snapshot. */
+  typedef struct {
+    QHostAddress addr;
+    uint16_t port;
+    qint64 lastSeen;
+  } Endpoint;
+
+protected:
+  Application &_application;
+  /** Writes the snapshot file. */
+  DeferredSave _writer;
+  /** Updates the snapshot periodically. */
+  QTimer _saveTimer;
+  /** Last known endpoints of buddy nodes, read from the snapshot. These are kept for nodes not
+   * seen during this session. */
+  QHash<Identifier, Endpoint> _buddyNodes;
+  /** Time (s since epoch) each node responded last, used to select the peers stored. */
+  QHash<Identifier, qint64> _lastSeen;
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,329 @@
+#include "socksproxy.hh"
+#include "application.hh"
+#include <ovlnet/socks.hh>
+#include <ovlnet/logger.hh>
+
+
+/* ********************************************************************************************* *
+ * Implementation of SocksProxy::Tunnel
+ * ********************************************************************************************* */
+SocksProxy::Tunnel::Tunnel(const NodeItem &node)
+  : _node(node), _connections(0), _totalConnections(0), _bytesReceived(0), _rtt(-1), _ping()
+{
+  // pass...
+}
+
+const NodeItem &
+SocksProxy::Tunnel::node() const {
+  return _node;
+}
+
+size_t
+SocksProxy::Tunnel::connections() const {
+  return _connections;
+}
+
+size_t
+SocksProxy::Tunnel::totalConnections() const {
+  return _totalConnections;
+}
+
+quint64
+SocksProxy::Tunnel::bytesReceived() const {
+  return _bytesReceived;
+}
+
+double
+SocksProxy::Tunnel::rtt() const {
+  return _rtt;
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of SocksProxy
+ * ********************************************************************************************* */
+SocksProxy::SocksProxy(Application &app, uint16_t port, QObject *parent)
+  : QAbstractTableModel(parent), _application(app), _server(), _policy(LEAST_RTT), _tunnels(),
+    _last(-1), _connections(), _sticky(), _pingTimer(), _updateTimer()
+{
+  if (! _server.listen(QHostAddress::LocalHost, port)) {
+    logError() << "SocksProxy: Cannot listen on port " << port << ": "
+               << _server.errorString();
+  }
+
+  // Ping exit nodes every 10 seconds to measure the RTT
+  _pingTimer.setInterval(1000*10);
+  _pingTimer.setSingleShot(false);
+  // Update statistics once a second rather than for every packet
+  _updateTimer.setInterval(1000);
+  _updateTimer.setSingleShot(false);
+
+  connect(&_server, SIGNAL(newConnection()), this, SLOT(_onNewConnection()));
+  connect(&_application.dht(), SIGNAL(nodeReachable(NodeItem)),
+          this, SLOT(_onNodeReachable(NodeItem)));
+  connect(&_pingTimer, SIGNAL(timeout()), this, SLOT(_onPing()));
+  connect(&_updateTimer, SIGNAL(timeout()), this, SLOT(_onUpdate()));
+
+  _pingTimer.start();
+  _updateTimer.start();
+}
+
+SocksProxy::~SocksProxy() {
+  // Open sockets are destroyed with the server, after the connection table and the tunnels
+  QHash<QTcpSocket *, Tunnel *>::iterator connection = _connections.begin();
+  for (; connection != _connections.end(); connection++) {
+    disconnect(connection.key(), 0, this, 0);
+  }
+  _connections.clear();
+  _server.close();
+  QVector<Tunnel *>::iterator tunnel = _tunnels.begin();
+  for (; tunnel != _tunnels.end(); tunnel++) {
+    delete *tunnel;
+  }
+}
+
+bool
+SocksProxy::isListening() const {
+  return _server.isListening();
+}
+
+uint16_t
+SocksProxy::port() const {
+  return _server.serverPort();
+}
+
+SocksProxy::Policy
+SocksProxy::policy() const {
+  return _policy;
+}
+
+void
+SocksProxy::setPolicy(Policy policy) {
+  _policy = policy;
+  _sticky.clear();
+}
+
+size_t
+SocksProxy::numTunnels() const {
+  return _tunnels.size();
+}
+
+bool
+SocksProxy::hasTunnel(const Identifier &id) const {
+  for (int i=0; i<_tunnels.size(); i++) {
+    if (_tunnels[i]->_node.id() == id) { return true; }
+  }
+  return false;
+}
+
+void
+SocksProxy::addTunnel(const NodeItem &node) {
+  if (hasTunnel(node.id())) { return; }
+  beginInsertRows(QModelIndex(), _tunnels.size(), _tunnels.size());
+  Tunnel *tunnel = new Tunnel(node);
+  _tunnels.append(tunnel);
+  endInsertRows();
+  // Measure RTT right away
+  tunnel->_ping.start();
+  _application.dht().ping(node.addr(), node.port());
+}
+
+void
+SocksProxy::delTunnel(int idx) {
+  if ((idx < 0) || (idx >= _tunnels.size())) { return; }
+  Tunnel *tunnel = _tunnels[idx];
+  beginRemoveRows(QModelIndex(), idx, idx);
+  _tunnels.remove(idx);
+  endRemoveRows();
+
+  // Open connections keep running but are not accounted anymore
+  QHash<QTcpSocket *, Tunnel *>::iterator conn = _connections.begin();
+  while (conn != _connections.end()) {
+    if (tunnel == conn.value()) { conn = _connections.erase(conn); }
+    else { conn++; }
+  }
+  QHash<QString, Tunnel *>::iterator host = _sticky.begin();
+  while (host != _sticky.end()) {
+    if (tunnel == host.value()) { host = _sticky.erase(host); }
+    else { host++; }
+  }
+  delete tunnel;
+  if (_last >= _tunnels.size()) { _last = -1; }
+  emit connectionCountChanged(connectionCount());
+}
+
+size_t
+SocksProxy::connectionCount() const {
+  return _connections.size();
+}
+
+int
+SocksProxy::_select(const QHostAddress &client) {
+  if (0 == _tunnels.size()) { return -1; }
+
+  if (STICKY == _policy) {
+    QString key = client.toString();
+    if (! _sticky.contains(key)) {
+      // Assign new client host to the tunnel with the fewest connections
+      int best = 0;
+      for (int i=1; i<_tunnels.size(); i++) {
+        if (_tunnels[i]->_connections < _tunnels[best]->_connections) { best = i; }
+      }
+      _sticky.insert(key, _tunnels[best]);
+    }
+    return _tunnels.indexOf(_sticky[key]);
+  }
+
+  if (LEAST_RTT == _policy) {
+    int best = -1;
+    for (int i=0; i<_tunnels.size(); i++) {
+      if (_tunnels[i]->_rtt < 0) { continue; }
+      if ((best < 0) || (_tunnels[i]->_rtt < _tunnels[best]->_rtt)) { best = i; }
+    }
+    // If no RTT is known yet -> fall back to round-robin
+    if (best >= 0) { _last = best; return best; }
+  }
+
+  _last = (_last+1) % _tunnels.size();
+  return _last;
+}
+
+void
+SocksProxy::_onNewConnection() {
+  while (_server.hasPendingConnections()) {
+    QTcpSocket *socket = _server.nextPendingConnection();
+    int idx = _select(socket->peerAddress());
+    if (idx < 0) {
+      logWarning() << "SocksProxy: No exit node available, close connection.";
+      socket->close(); socket->deleteLater();
+      continue;
+    }
+
+    Tunnel *tunnel = _tunnels[idx];
+    tunnel->_connections++;
+    tunnel->_totalConnections++;
+    _connections.insert(socket, tunnel);
+    connect(socket, SIGNAL(bytesWritten(qint64)), this, SLOT(_onBytesWritten(qint64)));
+    connect(socket, SIGNAL(disconnected()), this, SLOT(_onDisconnected()));
+    connect(socket, SIGNAL(destroyed(QObject*)), this, SLOT(_onSocketDestroyed(QObject*)));
+
+    logDebug() << "SocksProxy: Forward connection from " << socket->peerAddress().toString()
+               << " to " << tunnel->_node.id();
+    LocalSocksStream *stream = new LocalSocksStream(_application.dht(), socket);
+    _application.dht().startConnection("socks", tunnel->_node, stream);
+    emit connectionCountChanged(connectionCount());
+  }
+}
+
+void
+SocksProxy::_onBytesWritten(qint64 bytes) {
+  QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+  if (! _connections.contains(socket)) { return; }
+  _connections[socket]->_bytesReceived += bytes;
+}
+
+void
+SocksProxy::_onDisconnected() {
+  _closed(qobject_cast<QTcpSocket *>(sender()));
+}
+
+void
+SocksProxy::_onSocketDestroyed(QObject *socket) {
+  // The socket is already destroyed, only its address is used as the key.
+  _closed(static_cast<QTcpSocket *>(socket));
+}
+
+void
+SocksProxy::_closed(QTcpSocket *socket) {
+  if (! _connections.contains(socket)) { return; }
+  _connections[socket]->_connections--;
+  _connections.remove(socket);
+  emit connectionCountChanged(connectionCount());
+}
+
+void
+SocksProxy::_onNodeReachable(const NodeItem &node) {
+  for (int i=0; i<_tunnels.size(); i++) {
+    Tunnel *tunnel = _tunnels[i];
+    if (tunnel->_node.id() != node.id()) { continue; }
+    // Exit node may have changed its address
+    tunnel->_node = node;
+    if (! tunnel->_ping.isValid()) { return; }
+    // Update smoothed RTT
+    double rtt = tunnel->_ping.elapsed();
+    if (tunnel->_rtt < 0) { tunnel->_rtt = rtt; }
+    else { tunnel->_rtt = 0.875*tunnel->_rtt + 0.125*rtt; }
+    tunnel->_ping.invalidate();
+    return;
+  }
+}
+
+void
+SocksProxy::_onPing() {
+  QVector<Tunnel *>::iterator tunnel = _tunnels.begin();
+  for (; tunnel != _tunnels.end(); tunnel++) {
+    (*tunnel)->_ping.start();
+    _application.dht().ping((*tunnel)->_node.addr(), (*tunnel)->_node.port());
+  }
+}
+
+void
+SocksProxy::_onUpdate() {
+  if (0 == _tunnels.size()) { return; }
+  emit dataChanged(index(0, 0), index(_tunnels.size()-1, columnCount(QModelIndex())-1));
+}
+
+int
+SocksProxy::rowCount(const QModelIndex &parent) const {
+  if (parent.isValid()) { return 0; }
+  return _tunnels.size();
+}
+
+int
+SocksProxy::columnCount(const QModelIndex &parent) const {
+  return 5;
+}
+
+QVariant
+SocksProxy::data(const QModelIndex &index, int role) const {
+  if (! index.isValid()) { return QVariant(); }
+  if (index.row() >= _tunnels.size()) { return QVariant(); }
+  if (Qt::DisplayRole != role) { return QVariant(); }
+
+  Tunnel *tunnel = _tunnels[index.row()];
+  switch (index.column()) {
+  case 0:
+    if (_application.buddies().hasNode(tunnel->_node.id())) {
+      return _application.buddies().buddyName(tunnel->_node.id());
+    }
+    return tunnel->_node.id().toBase32();
+  case 1:
+    if (tunnel->_rtt < 0) { return tr("unknown"); }
+    return tr("%1ms").arg(QString::number(tunnel->_rtt, 'f', 0));
+  case 2: return uint(tunnel->_connections);
+  case 3: return uint(tunnel->_totalConnections);
+  case 4:
+    if (tunnel->_bytesReceived < 2000UL) {
+      return QString("%1b").arg(tunnel->_bytesReceived);
+    } else if (tunnel->_bytesReceived < 2000000UL) {
+      return QString("%1kb").arg(tunnel->_bytesReceived/1000UL);
+    }
+    return QString("%1Mb").arg(tunnel->_bytesReceived/1000000UL);
+  default: break;
+  }
+  return QVariant();
+}
+
+QVariant
+SocksProxy::headerData(int section, Qt::Orientation orientation, int role) const {
+  if ((Qt::Horizontal != orientation) || (Qt::DisplayRole != role)) { return QVariant(); }
+  switch (section) {
+  case 0: return tr("Exit node");
+  case 1: return tr("RTT");
+  case 2: return tr("Open");
+  case 3: return tr("Total");
+  case 4: return tr("Received");
+  default: break;
+  }
+  return QVariant();
+}
@@ -0,0 +1,128 @@
+#ifndef SOCKSPROXY_H
+#define SOCKSPROXY_H
+
+#include <QAbstractTableModel>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QHash>
+#include <QVector>
+#include <ovlnet/node.hh>
+
+class Application;
+
+
+/** A local SOCKS proxy, distributing incoming connections over several exit nodes (tunnels)
+ * behind a single listener. Also collects some statistics for each tunnel. */
+class SocksProxy : public QAbstractTableModel
+{
+  Q_OBJECT
+
+public:
+  /** Possible strategies to select the exit node for a new connection. */
+  typedef enum {
+    LEAST_RTT,   ///< Selects the tunnel with the lowest round-trip time.
+    ROUND_ROBIN, ///< Cycles through all tunnels.
+    STICKY       ///< Connections of the same client host always use the same tunnel.
+  } Policy;
+
+  /** Represents a single exit node and its statistics. */
+  class Tunnel
+  {
+  public:
+    Tunnel(const NodeItem &node);
+
+    /** Returns the exit node of the tunnel. */
+    const NodeItem &node() const;
+    /** Returns the number of currently open connections. */
+    size_t connections() const;
+    /** Returns the total number of connections made through this tunnel. */
+    size_t totalConnections() const;
+    /** Returns the number of bytes delivered to local clients through this tunnel. */
+    quint64 bytesReceived() const;
+    /** Returns the smoothed round-trip time to the exit node in ms or -1 if unknown. */
+    double rtt() const;
+
+  protected:
+    NodeItem _node;
+    size_t _connections;
+    size_t _totalConnections;
+    quint64 _bytesReceived;
+    double _rtt;
+    /** Measures the time since the last ping. */
+    QElapsedTimer _ping;
+    friend class SocksProxy;
+  };
+
+public:
+  /** Constructor, starts listening on the given local port. */
+  explicit SocksProxy(Application &app, uint16_t port=1080, QObject *parent=0);
+  /** Destructor. */
+  virtual ~SocksProxy();
+
+  /** Returns @c true if the proxy is listening for incoming connections. */
+  bool isListening() const;
+  /** Returns the local port, the proxy is listening on. */
+  uint16_t port() const;
+
+  /** Returns the current routing policy. */
+  Policy policy() const;
+  /** Sets the routing policy. */
+  void setPolicy(Policy policy);
+
+  /** Returns the number of tunnels. */
+  size_t numTunnels() const;
+  /** Returns @c true if the given node is an exit node of this proxy. */
+  bool hasTunnel(const Identifier &id) const;
+  /** Adds an exit node. */
+  void addTunnel(const NodeItem &node);
+  /** Removes the exit node at the given index. Open connections are not affected. */
+  void delTunnel(int idx);
+
+  /** Returns the number of open connections over all tunnels. */
+  size_t connectionCount() const;
+
+  // Implementation of QAbstractTableModel
+  int rowCount(const QModelIndex &parent) const;
+  int columnCount(const QModelIndex &parent) const;
+  QVariant data(const QModelIndex &index, int role) const;
+  QVariant headerData(int section, Qt::Orientation orientation, int role) const;
+
+signals:
+  /** Gets emitted if a connection is opened or closed. */
+  void connectionCountChanged(size_t count);
+
+protected slots:
+  void _onNewConnection();
+  void _onBytesWritten(qint64 bytes);
+  void _onDisconnected();
+  void _onSocketDestroyed(QObject *socket);
+  void _onNodeReachable(const NodeItem &node);
+  void _onPing();
+  void _onUpdate();
+
+protected:
+  /** Selects the tunnel for a new connection from the given client or -1 if there is none. */
+  int _select(const QHostAddress &client);
+  /** Removes the given socket from the connection table and updates the statistics. */
+  void _closed(QTcpSocket *socket);
+
+protected:
+  Application &_application;
+  QTcpServer _server;
+  Policy _policy;
+  QVector<Tunnel *> _tunnels;
+  /** Index of the tunnel used last (round-robin). */
+  int _last;
+  /** Table of open connections and the tunnel they use. */
+  QHash<QTcpSocket *, Tunnel *> _connections;
+  /** Assigns client hosts to tunnels (sticky policy). */
+  QHash<QString, Tunnel *> _sticky;
+  /** Pings the exit nodes to measure the RTT. */
+  QTimer _pingTimer;
+  /** Updates the statistics in the view. */
+  QTimer _updateTimer;
+};
+
+#endif // SOCKSPROXY_H
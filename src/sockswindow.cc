@@ -3,37 +3,69 @@
 #include <QImage>
 #include <QPushButton>
 #include <QHBoxLayout>
+#include <QVBoxLayout>
+#include <QHeaderView>
 #include <QCloseEvent>
 
 
-SocksWindow::SocksWindow(Application &app, const NodeItem &node, QWidget *parent)
-  : QWidget(parent), _application(app), _socks(app.dht(), node)
+SocksWindow::SocksWindow(Application &app, QWidget *parent)
+  : QWidget(parent), _application(app), _proxy(app)
 {
-  _info = new QLabel(tr("Started SOCKS proxy service."));
-  if (!_socks.isListening()) {
+  setWindowTitle(tr("SOCKS proxy"));
+  setMinimumWidth(500);
+
+  _info = new QLabel(tr("Started SOCKS proxy service on port %1.").arg(_proxy.port()));
+  if (!_proxy.isListening()) {
     _info->setText(tr("Error while starting SOCKS proxy service."));
   }
-  _connectionCount = new QLabel(tr("Connections: %1").arg(_socks.connectionCount()));
+  _connectionCount = new QLabel(tr("Connections: %1").arg(_proxy.connectionCount()));
+
+  _policy = new QComboBox();
+  _policy->addItem(tr("Lowest RTT"), int(SocksProxy::LEAST_RTT));
+  _policy->addItem(tr("Round robin"), int(SocksProxy::ROUND_ROBIN));
+  _policy->addItem(tr("Sticky per client"), int(SocksProxy::STICKY));
+
+  _tunnels = new QTableView();
+  _tunnels->setModel(&_proxy);
+  _tunnels->setSelectionBehavior(QAbstractItemView::SelectRows);
+  _tunnels->setSelectionMode(QAbstractItemView::SingleSelection);
+  _tunnels->horizontalHeader()->setStretchLastSection(true);
 
   QLabel *icon = new QLabel();
   icon->setPixmap(
         QPixmap::fromImage(QImage("://icons/world.png")));
-  QPushButton *stop = new QPushButton(QIcon("://icons/circle-x.png"), tr("stop"));
+  QPushButton *remove = new QPushButton(QIcon("://icons/circle-x.png"), tr("remove"));
+  QPushButton *stop = new QPushButton(QIcon("://icons/power-standby.png"), tr("stop"));
 
-  QHBoxLayout *layout = new QHBoxLayout();
-  layout->addWidget(icon);
+  QVBoxLayout *layout = new QVBoxLayout();
+  QHBoxLayout *header = new QHBoxLayout();
+  header->addWidget(icon);
   QVBoxLayout *infobox = new QVBoxLayout();
   infobox->addWidget(_info);
   infobox->addWidget(_connectionCount);
-  layout->addLayout(infobox);
-  layout->addWidget(stop);
+  header->addLayout(infobox, 1);
+  header->addWidget(_policy);
+  layout->addLayout(header);
+  layout->addWidget(_tunnels, 1);
+  QHBoxLayout *bbox = new QHBoxLayout();
+  bbox->addStretch(1);
+  bbox->addWidget(remove);
+  bbox->addWidget(stop);
+  layout->addLayout(bbox);
   setLayout(layout);
 
   connect(stop, SIGNAL(clicked()), this, SLOT(close()));
-  connect(&_socks, SIGNAL(connectionCountChanged(size_t)),
+  connect(remove, SIGNAL(clicked()), this, SLOT(_onRemoveTunnel()));
+  connect(_policy, SIGNAL(currentIndexChanged(int)), this, SLOT(_onPolicySelected(int)));
+  connect(&_proxy, SIGNAL(connectionCountChanged(size_t)),
           this, SLOT(_onConnectionCountChanged(size_t)));
 }
 
+void
+SocksWindow::addTunnel(const NodeItem &node) {
+  _proxy.addTunnel(node);
+}
+
 void
 SocksWindow::closeEvent(QCloseEvent *evt) {
   evt->accept();
@@ -42,5 +74,17 @@ SocksWindow::closeEvent(QCloseEvent *evt) {
 
 void
 SocksWindow::_onConnectionCountChanged(size_t count) {
-  _connectionCount->setText(tr("Connections: %1").arg(_socks.connectionCount()));
+  _connectionCount->setText(tr("Connections: %1").arg(_proxy.connectionCount()));
+}
+
+void
+SocksWindow::_onPolicySelected(int idx) {
+  _proxy.setPolicy(SocksProxy::Policy(_policy->itemData(idx).toInt()));
+}
+
+void
+SocksWindow::_onRemoveTunnel() {
+  QModelIndexList items = _tunnels->selectionModel()->selectedRows();
+  if (0 == items.size()) { return; }
+  _proxy.delTunnel(items.first().row());
 }
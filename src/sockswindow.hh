@@ -3,7 +3,9 @@
 
 #include <QWidget>
 #include <QLabel>
-#include <ovlnet/socks.hh>
+#include <QComboBox>
+#include <QTableView>
+#include "socksproxy.hh"
 
 class Application;
 
@@ -12,20 +14,27 @@ class SocksWindow : public QWidget
   Q_OBJECT
 
 public:
-  explicit SocksWindow(Application &app, const NodeItem &node, QWidget *parent = 0);
+  explicit SocksWindow(Application &app, QWidget *parent = 0);
+
+  /** Adds the given node as an exit node to the proxy. */
+  void addTunnel(const NodeItem &node);
 
 protected slots:
   void _onConnectionCountChanged(size_t count);
+  void _onPolicySelected(int idx);
+  void _onRemoveTunnel();
 
 protected:
   void closeEvent(QCloseEvent *evt);
 
 protected:
   Application &_application;
-  LocalSocksService _socks;
+  SocksProxy _proxy;
 
   QLabel *_info;
   QLabel *_connectionCount;
+  QComboBox *_policy;
+  QTableView *_tunnels;
 };
 
 #endif // SOCKSWINDOW_H
@@ -0,0 +1,72 @@
+#include "sparkline.hh"
+#include <QPainter>
+#include <QPen>
+#include <QBrush>
+#include <QColor>
+#include <QPolygonF>
+#include <algorithm>
+
+
+Sparkline::Sparkline(QWidget *parent)
+  : QWidget(parent), _buckets(), _maximum(0), _average(0)
+{
+  setMinimumWidth(300);
+  setMinimumHeight(30);
+}
+
+void
+Sparkline::update(const QVector<TimeSeries::Bucket> &buckets) {
+  _buckets = buckets;
+  _maximum = 0; _average = 0;
+  double sum = 0; size_t count = 0;
+  QVector<TimeSeries::Bucket>::const_iterator bucket = _buckets.begin();
+  for (; bucket != _buckets.end(); bucket++) {
+    if (0 == bucket->count) { continue; }
+    _maximum = std::max(_maximum, double(bucket->max));
+    sum += bucket->sum; count += bucket->count;
+  }
+  if (count) { _average = sum/count; }
+  QWidget::update();
+}
+
+double
+Sparkline::maximum() const {
+  return _maximum;
+}
+
+double
+Sparkline::average() const {
+  return _average;
+}
+
+void
+Sparkline::paintEvent(QPaintEvent *evt) {
+  QPainter painter(this);
+  painter.fillRect(rect(), "white");
+  if (_buckets.isEmpty()) { return; }
+
+  int margin = 2;
+  double w = width()-2*margin, h = height()-2*margin;
+  double dx = w/_buckets.size();
+  double scale = (_maximum > 0) ? h/_maximum : 0;
+
+  // Draw each contiguous run of non-empty buckets as band and line
+  QPolygonF band, line;
+  for (int i=0; i<=_buckets.size(); i++) {
+    if ((i < _buckets.size()) && _buckets[i].count) {
+      const TimeSeries::Bucket &bucket = _buckets[i];
+      double x = margin + (i+0.5)*dx;
+      band.prepend(QPointF(x, margin+h-scale*bucket.max));
+      band.append(QPointF(x, margin+h-scale*bucket.min));
+      line.append(QPointF(x, margin+h-scale*bucket.sum/bucket.count));
+      continue;
+    }
+    if (line.isEmpty()) { continue; }
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(QBrush(QColor(0xc0, 0xd0, 0xf0)));
+    painter.drawPolygon(band);
+    painter.setPen(QPen(Qt::blue, 1));
+    painter.drawPolyline(line);
+    band.clear(); line.clear();
+  }
+}
@@ -0,0 +1,37 @@
+#ifndef SPARKLINE_H
+#define SPARKLINE_H
+
+#include <QWidget>
+#include "history.hh"
+
+
+/** Draws the buckets of a time series as a sparkline. The average is shown as a line, the
+ * range between minimum and maximum as a band around it. */
+class Sparkline : public QWidget
+{
+  Q_OBJECT
+
+public:
+  explicit Sparkline(QWidget *parent = 0);
+
+  /** Updates the buckets shown. */
+  void update(const QVector<TimeSeries::Bucket> &buckets);
+
+  /** Returns the maximum of the buckets shown. */
+  double maximum() const;
+  /** Returns the average of the buckets shown. */
+  double average() const;
+
+protected:
+  virtual void paintEvent(QPaintEvent *evt);
+
+protected:
+  /** The buckets shown. */
+  QVector<TimeSeries::Bucket> _buckets;
+  /** The maximum of all buckets. */
+  double _maximum;
+  /** The average of all buckets. */
+  double _average;
+};
+
+#endif // SPARKLINE_H
@@ -0,0 +1,850 @@
+#include "transfer.hh"
+#include <ovlnet/filetransfer.hh>
+#include <ovlnet/logger.hh>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QTemporaryDir>
+#include <QStorageInfo>
+#include <QFileInfo>
+#include <QDir>
+#include <QDirIterator>
+#include <QMutexLocker>
+#include <QtEndian>
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#define TRANSFER_MAGIC          "OVLT"
+#define TRANSFER_VERSION        4
+#define TRANSFER_HEADER_SIZE    8
+#define TRANSFER_RECORD_SIZE    8
+// Size of the file chunks, a multiple of the packet payload
+#define TRANSFER_CHUNK_SIZE     (32*FILETRANSFER_MAX_DATA_LEN)
+// Largest record payload (a chunk with its hash)
+#define TRANSFER_MAX_RECORD     (TRANSFER_CHUNK_SIZE+TRANSFER_HASH_SIZE)
+// Number of bytes sampled to estimate the entropy of a chunk
+#define TRANSFER_SAMPLE_SIZE    4096
+// Size of the evenly spaced blocks the sample is taken from
+#define TRANSFER_SAMPLE_BLOCK   256
+// Chunks with a larger entropy (bits per byte) are sent uncompressed
+#define TRANSFER_MAX_ENTROPY    7.5
+
+// Size of a manifest entry without the name
+#define TRANSFER_ENTRY_SIZE     10
+
+// Header flags
+#define TRANSFER_BATCH          0x01
+// Compression methods
+#define TRANSFER_METHOD_NONE    0
+#define TRANSFER_METHOD_ZLIB    1
+// Record types
+#define TRANSFER_DATA           1
+#define TRANSFER_END            2
+#define TRANSFER_MANIFEST       3
+#define TRANSFER_FILE           4
+// Record flags
+#define TRANSFER_COMPRESSED     0x01
+
+
+/* Estimates the entropy (bits per byte) of the given chunk from a sample. */
+static double
+entropy(const uchar *data, size_t len) {
+  quint32 histogram[256];
+  memset(histogram, 0, sizeof(histogram));
+  size_t stride = std::max<size_t>(
+        TRANSFER_SAMPLE_BLOCK, len/(TRANSFER_SAMPLE_SIZE/TRANSFER_SAMPLE_BLOCK));
+  size_t count = 0;
+  for (size_t offset=0; offset<len; offset += stride) {
+    size_t end = std::min(len, offset+TRANSFER_SAMPLE_BLOCK);
+    for (size_t i=offset; i<end; i++, count++) {
+      histogram[data[i]]++;
+    }
+  }
+  double h = 0;
+  for (int i=0; i<256; i++) {
+    if (0 == histogram[i]) { continue; }
+    double p = double(histogram[i])/count;
+    h -= p*std::log2(p);
+  }
+  return h;
+}
+
+/* Serializes the header of a record. The payload may be preceded by a hash. */
+static void
+recordHeader(uchar *header, uint8_t type, uint8_t flags, size_t len, const uchar *hash) {
+  memset(header, 0, TRANSFER_RECORD_SIZE);
+  header[0] = type; header[1] = flags;
+  qToLittleEndian<quint32>(len + (hash ? TRANSFER_HASH_SIZE : 0), header+4);
+}
+
+/* Appends a record to a buffer. */
+static void
+appendRecord(QByteArray &buffer, uint8_t type, uint8_t flags, const char *payload, size_t len,
+             const uchar *hash=0)
+{
+  uchar header[TRANSFER_RECORD_SIZE];
+  recordHeader(header, type, flags, len, hash);
+  buffer.append((const char *)header, TRANSFER_RECORD_SIZE);
+  if (hash) { buffer.append((const char *)hash, TRANSFER_HASH_SIZE); }
+  buffer.append(payload, len);
+}
+
+/* Appends a record to the packed file. */
+static bool
+writeRecord(QFile &file, uint8_t type, uint8_t flags, const char *payload, size_t len,
+            const uchar *hash=0)
+{
+  uchar header[TRANSFER_RECORD_SIZE];
+  recordHeader(header, type, flags, len, hash);
+  if (TRANSFER_RECORD_SIZE != file.write((const char *)header, TRANSFER_RECORD_SIZE)) {
+    return false;
+  }
+  if (hash && (TRANSFER_HASH_SIZE != file.write((const char *)hash, TRANSFER_HASH_SIZE))) {
+    return false;
+  }
+  return (qint64(len) == file.write(payload, len));
+}
+
+/* Lists the files to send. A single directory is sent with all its files, named relative to
+ * the directory. */
+static bool
+collect(const QStringList &paths, QVector<TransferEntry> &entries, QString &error) {
+  if ((1 == paths.size()) && QFileInfo(paths.first()).isDir()) {
+    QDir dir(paths.first());
+    QDirIterator it(dir.absolutePath(), QDir::Files | QDir::Hidden | QDir::NoSymLinks,
+                    QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+      it.next();
+      TransferEntry entry;
+      entry.path = it.filePath();
+      entry.name = dir.relativeFilePath(it.filePath());
+      entry.size = it.fileInfo().size();
+      entries.append(entry);
+    }
+  } else {
+    foreach (QString path, paths) {
+      QFileInfo fileinfo(path);
+      TransferEntry entry;
+      entry.path = fileinfo.absoluteFilePath();
+      entry.name = fileinfo.fileName();
+      entry.size = fileinfo.size();
+      entries.append(entry);
+    }
+  }
+  if (entries.isEmpty()) {
+    error = QObject::tr("No files to send.");
+    return false;
+  }
+  return true;
+}
+
+/* Serializes the header and the manifest, the latter split into records of at most one
+ * chunk. */
+static QByteArray
+prefix(const QVector<TransferEntry> &entries, bool compress, bool batch) {
+  uchar header[TRANSFER_HEADER_SIZE];
+  memset(header, 0, TRANSFER_HEADER_SIZE);
+  memcpy(header, TRANSFER_MAGIC, 4);
+  header[4] = TRANSFER_VERSION;
+  header[5] = compress ? TRANSFER_METHOD_ZLIB : TRANSFER_METHOD_NONE;
+  // Anything but a single file is saved into a directory by the receiver
+  if (batch) { header[6] |= TRANSFER_BATCH; }
+  QByteArray data((const char *)header, TRANSFER_HEADER_SIZE);
+
+  QByteArray manifest;
+  for (int i=0; i<entries.size(); i++) {
+    QByteArray name = entries[i].name.toUtf8();
+    if ((manifest.size() + TRANSFER_ENTRY_SIZE + name.size()) > TRANSFER_CHUNK_SIZE) {
+      appendRecord(data, TRANSFER_MANIFEST, 0, manifest.constData(), manifest.size());
+      manifest.clear();
+    }
+    uchar entry[TRANSFER_ENTRY_SIZE];
+    qToLittleEndian<quint64>(entries[i].size, entry);
+    qToLittleEndian<quint16>(name.size(), entry+8);
+    manifest.append((const char *)entry, TRANSFER_ENTRY_SIZE);
+    manifest.append(name);
+  }
+  appendRecord(data, TRANSFER_MANIFEST, 0, manifest.constData(), manifest.size());
+  return data;
+}
+
+/* Returns the size of a file within an uncompressed transfer: the FILE record, a DATA record
+ * with a hash per chunk and the END record. */
+static qint64
+uncompressedSize(const TransferEntry &entry) {
+  qint64 chunks = (entry.size + TRANSFER_CHUNK_SIZE - 1)/TRANSFER_CHUNK_SIZE;
+  return (TRANSFER_RECORD_SIZE+4) + chunks*(TRANSFER_RECORD_SIZE+TRANSFER_HASH_SIZE) +
+      entry.size + (TRANSFER_RECORD_SIZE+TRANSFER_HASH_SIZE);
+}
+
+/* Appends the content of a single file. */
+static bool
+writeFile(QFile &out, quint32 index, const TransferEntry &entry, QByteArray &chunk,
+          qint64 &contentSize, QString &error)
+{
+  QFile in(entry.path);
+  if (! in.open(QIODevice::ReadOnly)) {
+    error = QObject::tr("Cannot open %1: %2").arg(entry.path).arg(in.errorString());
+    return false;
+  }
+  uchar idx[4]; qToLittleEndian<quint32>(index, idx);
+  if (! writeRecord(out, TRANSFER_FILE, 0, (const char *)idx, 4)) {
+    error = out.errorString();
+    return false;
+  }
+
+  MerkleTree tree;
+  uchar leaf[TRANSFER_HASH_SIZE];
+  qint64 len;
+  while (0 < (len = in.read(chunk.data(), TRANSFER_CHUNK_SIZE))) {
+    contentSize += len;
+    const uchar *data = (const uchar *)chunk.constData();
+    // Hash the content as read, the receiver verifies what it writes
+    MerkleTree::hash(chunk.constData(), len, leaf);
+    tree.add(leaf);
+    // Skip chunks that appear to be compressed already, keep the others only if they shrink
+    if (entropy(data, len) < TRANSFER_MAX_ENTROPY) {
+      QByteArray packed = qCompress(data, len);
+      if (packed.size() < len) {
+        if (! writeRecord(out, TRANSFER_DATA, TRANSFER_COMPRESSED,
+                          packed.constData(), packed.size(), leaf)) {
+          error = out.errorString();
+          return false;
+        }
+        continue;
+      }
+    }
+    if (! writeRecord(out, TRANSFER_DATA, 0, chunk.constData(), len, leaf)) {
+      error = out.errorString();
+      return false;
+    }
+  }
+  if (0 > len) {
+    error = QObject::tr("Cannot read %1: %2").arg(entry.path).arg(in.errorString());
+    return false;
+  }
+  uchar root[TRANSFER_HASH_SIZE];
+  tree.root(root);
+  if (! writeRecord(out, TRANSFER_END, 0, (const char *)root, TRANSFER_HASH_SIZE)) {
+    error = out.errorString();
+    return false;
+  }
+  return true;
+}
+
+/* Packs the given files into a single (compressed) file. */
+static bool
+pack(QFile &out, const QByteArray &prefix, const QVector<TransferEntry> &entries,
+     qint64 &contentSize, QString &error)
+{
+  if (prefix.size() != out.write(prefix)) {
+    error = out.errorString();
+    return false;
+  }
+  // Send files back-to-back, sharing the chunk buffer
+  QByteArray chunk(TRANSFER_CHUNK_SIZE, 0);
+  for (int i=0; i<entries.size(); i++) {
+    if (! writeFile(out, i, entries[i], chunk, contentSize, error)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Returns true if the given name of a received file is relative and stays inside the target
+ * directory. */
+static bool
+validName(const QString &name) {
+  if (name.isEmpty() || QDir::isAbsolutePath(name) || name.contains('\\') ||
+      name.contains(':')) {
+    return false;
+  }
+  foreach (QString part, name.split('/')) {
+    if (part.isEmpty() || ("." == part) || (".." == part)) { return false; }
+  }
+  return true;
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of MerkleTree
+ * ********************************************************************************************* */
+MerkleTree::MerkleTree()
+  : _stack()
+{
+  // pass...
+}
+
+void
+MerkleTree::hash(const char *data, size_t len, uchar *leaf) {
+  // OpenSSL selects the fastest implementation (e.g., SHA extensions) at runtime
+  const uchar prefix = 0x00;
+  EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+  EVP_DigestInit_ex(ctx, EVP_sha256(), 0);
+  EVP_DigestUpdate(ctx, &prefix, 1);
+  EVP_DigestUpdate(ctx, data, len);
+  EVP_DigestFinal_ex(ctx, leaf, 0);
+  EVP_MD_CTX_free(ctx);
+}
+
+/* Hashes an inner node. Leaves are prefixed by 0x00 and inner nodes by 0x01, hence a chunk
+ * cannot be passed off as an inner node. */
+static QByteArray
+hashNode(const QByteArray &left, const QByteArray &right) {
+  uchar node[1+2*TRANSFER_HASH_SIZE], hash[TRANSFER_HASH_SIZE];
+  node[0] = 0x01;
+  memcpy(node+1, left.constData(), TRANSFER_HASH_SIZE);
+  memcpy(node+1+TRANSFER_HASH_SIZE, right.constData(), TRANSFER_HASH_SIZE);
+  SHA256(node, sizeof(node), hash);
+  return QByteArray((const char *)hash, TRANSFER_HASH_SIZE);
+}
+
+void
+MerkleTree::add(const uchar *leaf) {
+  QByteArray node((const char *)leaf, TRANSFER_HASH_SIZE);
+  int height = 0;
+  // Merge complete subtrees of the same height
+  while ((! _stack.isEmpty()) && (_stack.last().first == height)) {
+    node = hashNode(_stack.last().second, node);
+    _stack.removeLast();
+    height++;
+  }
+  _stack.append(qMakePair(height, node));
+}
+
+void
+MerkleTree::root(uchar *hash) const {
+  if (_stack.isEmpty()) {
+    // The root of an empty file is the hash of no data
+    MerkleTree::hash(0, 0, hash);
+    return;
+  }
+  // Merge the remaining subtrees from right to left
+  QByteArray node = _stack.last().second;
+  for (int i=_stack.size()-2; i>=0; i--) {
+    node = hashNode(_stack[i].second, node);
+  }
+  memcpy(hash, node.constData(), TRANSFER_HASH_SIZE);
+}
+
+void
+MerkleTree::reset() {
+  _stack.clear();
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of TransferEncoder::State
+ * ********************************************************************************************* */
+TransferEncoder::State::State(TransferEncoder *owner)
+  : lock(), owner(owner), finished(false), entries(), prefix()
+{
+  // pass...
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of TransferEncoder::Task
+ * ********************************************************************************************* */
+class TransferEncoder::Task: public QRunnable
+{
+public:
+  Task(const QSharedPointer<State> &state, const QStringList &paths, const QString &filename,
+       bool compress)
+    : QRunnable(), _state(state), _paths(paths), _fileName(filename), _compress(compress)
+  {
+    // pass...
+  }
+
+  void run() {
+    QVector<TransferEntry> entries;
+    QByteArray header;
+    qint64 size = 0, contentSize = 0;
+    QString error;
+    bool success = collect(_paths, entries, error);
+    if (success) {
+      bool batch = (_paths.size() > 1) || QFileInfo(_paths.first()).isDir();
+      header = prefix(entries, _compress, batch);
+      size = header.size();
+      for (int i=0; i<entries.size(); i++) {
+        size += uncompressedSize(entries[i]);
+        contentSize += entries[i].size;
+      }
+    }
+    // Compressed transfers are packed, the uncompressed size is an upper bound of their size
+    if (success && _compress) {
+      contentSize = 0;
+      success = _pack(header, entries, size, contentSize, error);
+    }
+    // Remove the temporary directory (and a partially packed file) on error
+    if (_compress && (! success)) {
+      TransferEncoder::_discard(_fileName);
+    }
+
+    // Report result in the thread of the owner
+    QMutexLocker locker(&_state->lock);
+    _state->finished = true;
+    if (_state->owner) {
+      _state->entries = entries;
+      _state->prefix = header;
+      QMetaObject::invokeMethod(_state->owner, "_onPacked", Qt::QueuedConnection,
+                                Q_ARG(bool, success), Q_ARG(qint64, size),
+                                Q_ARG(int, entries.size()), Q_ARG(qint64, contentSize),
+                                Q_ARG(QString, error));
+    } else if (success && _compress) {
+      TransferEncoder::_discard(_fileName);
+    }
+  }
+
+protected:
+  /* Packs the files into the temporary file, updates the size. */
+  bool _pack(const QByteArray &header, const QVector<TransferEntry> &entries, qint64 &size,
+             qint64 &contentSize, QString &error)
+  {
+    // Fail early rather than filling up the (possibly memory backed) temporary directory
+    QStorageInfo storage(QFileInfo(_fileName).absolutePath());
+    if (storage.isValid() && (storage.bytesAvailable() < size)) {
+      error = QObject::tr("Not enough space in %1 to pack the files (%2 MB needed).")
+          .arg(storage.rootPath()).arg((size+999999)/1000000);
+      return false;
+    }
+    QFile out(_fileName);
+    bool success = out.open(QIODevice::WriteOnly);
+    if (! success) { error = out.errorString(); }
+    else { success = pack(out, header, entries, contentSize, error); }
+    size = out.size();
+    out.close();
+    return success;
+  }
+
+protected:
+  QSharedPointer<State> _state;
+  QStringList _paths;
+  QString _fileName;
+  bool _compress;
+};
+
+
+/* ********************************************************************************************* *
+ * Implementation of TransferEncoder
+ * ********************************************************************************************* */
+TransferEncoder::TransferEncoder(const QStringList &paths, const Identifier &peer, bool compress,
+                                 QObject *parent)
+  : QObject(parent), _paths(paths), _peer(peer), _compress(compress),
+    _state(new State(this)), _fileName(), _packed(false), _entries(), _prefix(), _size(0),
+    _numFiles(0), _contentSize(0), _error()
+{
+  // pass...
+}
+
+TransferEncoder::~TransferEncoder() {
+  QMutexLocker locker(&_state->lock);
+  _state->owner = 0;
+  // The packed file may be complete while the notification is still queued
+  if (_compress && _state->finished) { _discard(_fileName); }
+}
+
+void
+TransferEncoder::start() {
+  if (_paths.isEmpty()) {
+    _onPacked(false, 0, 0, 0, tr("No files to send."));
+    return;
+  }
+  // The transfer is named after the file, the directory or the directory of the files, as
+  // the name is sent to the receiver
+  QFileInfo fileinfo(_paths.first());
+  QString name = fileinfo.fileName();
+  if (_paths.size() > 1) { name = fileinfo.absoluteDir().dirName(); }
+  if (name.isEmpty()) { name = "files"; }
+  if (_compress) {
+    QTemporaryDir dir(QDir::temp().absoluteFilePath("ovlclient-XXXXXX"));
+    if (! dir.isValid()) {
+      _onPacked(false, 0, 0, 0, tr("Cannot create temporary directory."));
+      return;
+    }
+    dir.setAutoRemove(false);
+    _fileName = QDir(dir.path()).absoluteFilePath(name);
+  } else {
+    // Only the file name is used, the transfer is read from the files directly
+    _fileName = QDir(fileinfo.absolutePath()).absoluteFilePath(name);
+  }
+  QThreadPool::globalInstance()->start(new Task(_state, _paths, _fileName, _compress));
+}
+
+const Identifier &
+TransferEncoder::peer() const {
+  return _peer;
+}
+
+const QString &
+TransferEncoder::fileName() const {
+  return _fileName;
+}
+
+qint64
+TransferEncoder::size() const {
+  return _size;
+}
+
+int
+TransferEncoder::numFiles() const {
+  return _numFiles;
+}
+
+qint64
+TransferEncoder::contentSize() const {
+  return _contentSize;
+}
+
+const QString &
+TransferEncoder::errorString() const {
+  return _error;
+}
+
+QIODevice *
+TransferEncoder::open(QObject *parent) {
+  QIODevice *device = 0;
+  QIODevice::OpenMode mode = QIODevice::ReadOnly;
+  if (_packed) {
+    // Buffered, the stream reads the packed file in small chunks
+    device = new QFile(_fileName, parent);
+  } else {
+    // The reader buffers the files itself
+    device = new TransferReader(_prefix, _entries, parent);
+    mode |= QIODevice::Unbuffered;
+  }
+  if (! device->open(mode)) {
+    _error = device->errorString();
+    delete device;
+    return 0;
+  }
+  return device;
+}
+
+void
+TransferEncoder::_discard(const QString &filename) {
+  QFileInfo fileinfo(filename);
+  QFile::remove(fileinfo.absoluteFilePath());
+  QDir().rmdir(fileinfo.absolutePath());
+}
+
+void
+TransferEncoder::_onPacked(bool success, qint64 size, int numFiles, qint64 contentSize,
+                           const QString &error)
+{
+  _size = size; _numFiles = numFiles; _contentSize = contentSize; _error = error;
+  if (success) {
+    QMutexLocker locker(&_state->lock);
+    _entries = _state->entries; _prefix = _state->prefix;
+    _state->entries.clear(); _state->prefix.clear();
+    _packed = _compress;
+    logDebug() << "TransferEncoder: Prepared " << _numFiles << " files (" << _contentSize
+               << "b) as " << _size << "b" << (_packed ? " (packed)." : ".");
+  }
+  emit finished(success);
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of TransferReader
+ * ********************************************************************************************* */
+TransferReader::TransferReader(const QByteArray &prefix, const QVector<TransferEntry> &entries,
+                               QObject *parent)
+  : QIODevice(parent), _entries(entries), _index(-1), _file(), _tree(), _remaining(0),
+    _buffer(prefix), _offset(0), _chunk(TRANSFER_CHUNK_SIZE, 0), _failed(false)
+{
+  // pass...
+}
+
+bool
+TransferReader::isSequential() const {
+  return true;
+}
+
+qint64
+TransferReader::readData(char *data, qint64 maxlen) {
+  if (_failed) { return -1; }
+  qint64 n = 0;
+  while (n < maxlen) {
+    if (_offset >= _buffer.size()) {
+      // Report an error once the data read so far is consumed
+      if (! _next()) { _failed = true; return n ? n : -1; }
+      // End of transfer
+      if (_buffer.isEmpty()) { break; }
+    }
+    qint64 len = std::min<qint64>(maxlen-n, _buffer.size()-_offset);
+    memcpy(data+n, _buffer.constData()+_offset, len);
+    n += len; _offset += len;
+  }
+  return n;
+}
+
+qint64
+TransferReader::writeData(const char *data, qint64 len) {
+  Q_UNUSED(data); Q_UNUSED(len);
+  return -1;
+}
+
+bool
+TransferReader::_next() {
+  _buffer.clear(); _offset = 0;
+  if (_file.isOpen()) {
+    if (0 == _remaining) {
+      // Terminate the file
+      _file.close();
+      uchar root[TRANSFER_HASH_SIZE];
+      _tree.root(root);
+      appendRecord(_buffer, TRANSFER_END, 0, (const char *)root, TRANSFER_HASH_SIZE);
+      return true;
+    }
+    // The size was announced in the manifest, the file must not shrink meanwhile
+    qint64 len = std::min<qint64>(_remaining, TRANSFER_CHUNK_SIZE);
+    if (len != _file.read(_chunk.data(), len)) {
+      setErrorString(tr("Cannot read %1: %2").arg(_file.fileName())
+                     .arg(_file.error() ? _file.errorString() : tr("File changed.")));
+      _file.close();
+      return false;
+    }
+    _remaining -= len;
+    uchar leaf[TRANSFER_HASH_SIZE];
+    MerkleTree::hash(_chunk.constData(), len, leaf);
+    _tree.add(leaf);
+    appendRecord(_buffer, TRANSFER_DATA, 0, _chunk.constData(), len, leaf);
+    return true;
+  }
+  // All files sent
+  if ((_index+1) >= _entries.size()) { return true; }
+  _index++;
+  _file.setFileName(_entries[_index].path);
+  if (! _file.open(QIODevice::ReadOnly)) {
+    setErrorString(tr("Cannot open %1: %2").arg(_file.fileName()).arg(_file.errorString()));
+    return false;
+  }
+  _remaining = _entries[_index].size;
+  _tree.reset();
+  uchar idx[4]; qToLittleEndian<quint32>(_index, idx);
+  appendRecord(_buffer, TRANSFER_FILE, 0, (const char *)idx, 4);
+  return true;
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of TransferDecoder
+ * ********************************************************************************************* */
+TransferDecoder::TransferDecoder(const QString &path)
+  : _path(path), _batch(false), _entries(), _current(-1), _received(0), _file(), _tree(),
+    _chunk(0), _written(0), _corrupt(false), _corruptFiles(), _buffer(), _method(-1),
+    _complete(false), _contentSize(0), _error()
+{
+  // pass...
+}
+
+bool
+TransferDecoder::put(const uint8_t *data, size_t len) {
+  if (! _error.isEmpty()) { return false; }
+  _buffer.append((const char *)data, len);
+
+  // Check header
+  size_t offset = 0;
+  if (0 > _method) {
+    if (_buffer.size() < TRANSFER_HEADER_SIZE) { return true; }
+    const uchar *header = (const uchar *)_buffer.constData();
+    if ((0 != memcmp(header, TRANSFER_MAGIC, 4)) || (TRANSFER_VERSION != header[4]) ||
+        (TRANSFER_METHOD_ZLIB < header[5])) {
+      return _fail(QObject::tr("Unknown transfer format."));
+    }
+    _method = header[5];
+    _batch = (TRANSFER_BATCH & header[6]);
+    if (_batch && (! QDir().mkpath(_path))) {
+      return _fail(QObject::tr("Cannot create directory %1.").arg(_path));
+    }
+    offset = TRANSFER_HEADER_SIZE;
+  }
+
+  // Process complete records
+  while ((_buffer.size()-offset) >= TRANSFER_RECORD_SIZE) {
+    const uchar *record = (const uchar *)_buffer.constData() + offset;
+    quint32 length = qFromLittleEndian<quint32>(record+4);
+    if (length > TRANSFER_MAX_RECORD) {
+      return _fail(QObject::tr("Malformed transfer."));
+    }
+    if ((_buffer.size()-offset) < (TRANSFER_RECORD_SIZE+length)) { break; }
+    if (! _record(record[0], record[1], (const char *)record+TRANSFER_RECORD_SIZE, length)) {
+      return false;
+    }
+    offset += TRANSFER_RECORD_SIZE+length;
+  }
+  _buffer.remove(0, offset);
+  return true;
+}
+
+bool
+TransferDecoder::_record(uint8_t type, uint8_t flags, const char *payload, size_t len) {
+  if (_complete) {
+    return _fail(QObject::tr("Malformed transfer."));
+  }
+  if (TRANSFER_MANIFEST == type) {
+    // The manifest precedes all files
+    if ((0 <= _current) || _received) { return _fail(QObject::tr("Malformed transfer.")); }
+    return _manifest(payload, len);
+  }
+  if (TRANSFER_FILE == type) {
+    if ((0 <= _current) || (4 != len)) { return _fail(QObject::tr("Malformed transfer.")); }
+    return _open(qFromLittleEndian<quint32>((const uchar *)payload));
+  }
+  if (TRANSFER_END == type) {
+    if ((0 > _current) || (TRANSFER_HASH_SIZE != len)) {
+      return _fail(QObject::tr("Malformed transfer."));
+    }
+    return _close(payload, len);
+  }
+  if (TRANSFER_DATA != type) {
+    // Ignore unknown records
+    return true;
+  }
+  if ((0 > _current) || (len < TRANSFER_HASH_SIZE)) {
+    return _fail(QObject::tr("Malformed transfer."));
+  }
+  const uchar *expected = (const uchar *)payload;
+  payload += TRANSFER_HASH_SIZE; len -= TRANSFER_HASH_SIZE;
+  QByteArray chunk;
+  if (TRANSFER_COMPRESSED & flags) {
+    // Check the size of the chunk before it gets unpacked
+    if ((TRANSFER_METHOD_ZLIB != _method) || (len < 4) ||
+        (qFromBigEndian<quint32>((const uchar *)payload) > TRANSFER_CHUNK_SIZE)) {
+      return _fail(QObject::tr("Malformed transfer."));
+    }
+    chunk = qUncompress((const uchar *)payload, len);
+    if (chunk.isEmpty()) {
+      return _fail(QObject::tr("Malformed transfer."));
+    }
+    payload = chunk.constData(); len = chunk.size();
+  }
+  // Never write more than announced in the manifest
+  if ((len > TRANSFER_CHUNK_SIZE) || (qint64(len) > (_entries[_current].size-_written))) {
+    return _fail(QObject::tr("Malformed transfer."));
+  }
+  // Verify the chunk, the tree is built from the received content
+  uchar leaf[TRANSFER_HASH_SIZE];
+  MerkleTree::hash(payload, len, leaf);
+  _tree.add(leaf);
+  if (0 != memcmp(leaf, expected, TRANSFER_HASH_SIZE)) {
+    logWarning() << "TransferDecoder: Chunk " << _chunk << " of "
+                 << _entries[_current].name << " is corrupt.";
+    _corrupt = true;
+  }
+  _chunk++;
+  if (qint64(len) != _file.write(payload, len)) {
+    return _fail(_file.errorString());
+  }
+  _written += len;
+  _contentSize += len;
+  return true;
+}
+
+bool
+TransferDecoder::_manifest(const char *payload, size_t len) {
+  const uchar *ptr = (const uchar *)payload, *end = ptr+len;
+  while (ptr < end) {
+    if ((end-ptr) < TRANSFER_ENTRY_SIZE) { return _fail(QObject::tr("Malformed manifest.")); }
+    Entry entry;
+    entry.size = qFromLittleEndian<quint64>(ptr);
+    quint16 nameLength = qFromLittleEndian<quint16>(ptr+8);
+    ptr += TRANSFER_ENTRY_SIZE;
+    if ((end-ptr) < nameLength) { return _fail(QObject::tr("Malformed manifest.")); }
+    entry.name = QString::fromUtf8((const char *)ptr, nameLength);
+    ptr += nameLength;
+    // Never write outside of the target directory
+    if (! validName(entry.name)) {
+      return _fail(QObject::tr("Invalid file name \"%1\".").arg(entry.name));
+    }
+    _entries.append(entry);
+  }
+  if ((! _batch) && (_entries.size() > 1)) {
+    return _fail(QObject::tr("Malformed manifest."));
+  }
+  return true;
+}
+
+bool
+TransferDecoder::_open(quint32 index) {
+  // Files are sent in the order of the manifest
+  if ((int(index) != _received) || (int(index) >= _entries.size())) {
+    return _fail(QObject::tr("Malformed transfer."));
+  }
+  QString filename = _path;
+  if (_batch) {
+    filename = QDir(_path).absoluteFilePath(_entries[index].name);
+    if (! QDir().mkpath(QFileInfo(filename).absolutePath())) {
+      return _fail(QObject::tr("Cannot create directory %1.")
+                   .arg(QFileInfo(filename).absolutePath()));
+    }
+  }
+  _file.setFileName(filename);
+  // Write the chunks directly, they are large enough
+  if (! _file.open(QIODevice::WriteOnly | QIODevice::Unbuffered)) {
+    return _fail(QObject::tr("Cannot open %1: %2").arg(filename).arg(_file.errorString()));
+  }
+  _current = index;
+  _tree.reset(); _chunk = 0; _written = 0; _corrupt = false;
+  return true;
+}
+
+bool
+TransferDecoder::_close(const char *payload, size_t len) {
+  _file.close();
+  uchar root[TRANSFER_HASH_SIZE];
+  _tree.root(root);
+  // A truncated file is corrupt, even if its chunks verify
+  if (_corrupt || (_written != _entries[_current].size) || (0 != memcmp(root, payload, len))) {
+    logWarning() << "TransferDecoder: Verification of " << _entries[_current].name << " failed.";
+    _corruptFiles.append(_entries[_current].name);
+  }
+  _current = -1; _received++;
+  _complete = (_received == _entries.size());
+  return true;
+}
+
+bool
+TransferDecoder::isComplete() const {
+  return _complete;
+}
+
+int
+TransferDecoder::numFiles() const {
+  return _entries.size();
+}
+
+int
+TransferDecoder::filesReceived() const {
+  return _received;
+}
+
+qint64
+TransferDecoder::contentSize() const {
+  return _contentSize;
+}
+
+const QStringList &
+TransferDecoder::corruptFiles() const {
+  return _corruptFiles;
+}
+
+const QString &
+TransferDecoder::errorString() const {
+  return _error;
+}
+
+void
+TransferDecoder::close() {
+  _file.close();
+}
+
+bool
+TransferDecoder::_fail(const QString &error) {
+  _error = error;
+  _file.close();
+  return false;
+}
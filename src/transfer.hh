@@ -0,0 +1,275 @@
+#ifndef TRANSFER_H
+#define TRANSFER_H
+
+#include <QObject>
+#include <QIODevice>
+#include <QString>
+#include <QByteArray>
+#include <QFile>
+#include <QStringList>
+#include <QVector>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QPair>
+#include <ovlnet/node.hh>
+
+#define TRANSFER_HASH_SIZE 32
+
+
+/** Computes the SHA-256 Merkle tree root over the chunks of a file incrementally. The leaves
+ * are the hashes of the chunks prefixed by 0x00, inner nodes hash the concatenation of their
+ * children prefixed by 0x01. Only the roots of the complete subtrees are kept, hence the memory
+ * is logarithmic in the file size. */
+class MerkleTree
+{
+public:
+  /** Constructor. */
+  MerkleTree();
+
+  /** Computes the leaf hash of a chunk. */
+  static void hash(const char *data, size_t len, uchar *leaf);
+  /** Appends a leaf to the tree. */
+  void add(const uchar *leaf);
+  /** Computes the root of the tree. */
+  void root(uchar *hash) const;
+  /** Clears the tree. */
+  void reset();
+
+protected:
+  /** Roots of the complete subtrees and their heights. */
+  QVector< QPair<int, QByteArray> > _stack;
+};
+
+
+/** A file to send. */
+typedef struct {
+  /** The path of the file. */
+  QString path;
+  /** The name sent to the receiver, relative to the directory sent. */
+  QString name;
+  /** The size of the file. */
+  qint64 size;
+} TransferEntry;
+
+
+/** Packs one or more files for a single transfer. The stream of a file transfer starts with a
+ * header, specifying the format version and compression method, followed by a sequence of
+ * records. Each record consists of a type, flags, the payload length and the payload.
+ *
+ * The transfer starts with the manifest (one or more MANIFEST records), listing the name and
+ * size of each file. Then the files follow back-to-back, each one started by a FILE record. The
+ * file content is sent in DATA records, each holding a chunk of a fixed size (a multiple of the
+ * packet size) together with its SHA-256 hash. A chunk is compressed unless compression is
+ * disabled or the chunk appears to be incompressible. An END record terminates each file, it
+ * holds the root of the Merkle tree over the chunk hashes (see @c MerkleTree).
+ *
+ * As the size of a transfer must be known in advance, the files are listed in a background
+ * thread first. Without compression, the size follows from the manifest and the transfer is
+ * read directly from the files (see @c TransferReader). Compressed transfers are packed into a
+ * temporary file, which gets removed with the encoder. */
+class TransferEncoder : public QObject
+{
+  Q_OBJECT
+
+public:
+  /** Constructor.
+   * @param paths Specifies the files to send or a single directory, sent with all its files.
+   * @param peer Specifies the node, the files are sent to.
+   * @param compress If @c true, compressible chunks are compressed. */
+  TransferEncoder(const QStringList &paths, const Identifier &peer, bool compress,
+                  QObject *parent=0);
+  /** Destructor. */
+  virtual ~TransferEncoder();
+
+  /** Starts listing (and packing) the files, emits @c finished once done. */
+  void start();
+
+  /** The node, the files are sent to. */
+  const Identifier &peer() const;
+  /** Returns the name of the transfer as a path, only the file name is sent to the receiver.
+   * For a compressed transfer, this is the packed file. */
+  const QString &fileName() const;
+  /** Returns the size of the transfer. */
+  qint64 size() const;
+  /** Returns the number of files packed. */
+  int numFiles() const;
+  /** Returns the total size of the files. */
+  qint64 contentSize() const;
+  /** Returns a description of the error if packing failed. */
+  const QString &errorString() const;
+
+  /** Returns a new device reading the transfer (once @c finished) or 0 on error. */
+  QIODevice *open(QObject *parent=0);
+
+signals:
+  /** Gets emitted once the files are ready to send (or packing failed). */
+  void finished(bool success);
+
+protected slots:
+  void _onPacked(bool success, qint64 size, int numFiles, qint64 contentSize,
+                 const QString &error);
+
+protected:
+  /** The state shared with the background task. */
+  class State
+  {
+  public:
+    State(TransferEncoder *owner);
+
+  public:
+    QMutex lock;
+    /** The owner, gets notified once the file is packed. Set to 0 once the owner is
+     * destroyed. */
+    TransferEncoder *owner;
+    /** Set once the task finished, i.e. the packed file (if any) is complete. */
+    bool finished;
+    /** The files listed. */
+    QVector<TransferEntry> entries;
+    /** The header and manifest of the transfer. */
+    QByteArray prefix;
+  };
+
+  /** Packs the files in a background thread. */
+  class Task;
+
+  /** Deletes a packed file and its temporary directory. */
+  static void _discard(const QString &filename);
+
+protected:
+  QStringList _paths;
+  Identifier _peer;
+  bool _compress;
+  QSharedPointer<State> _state;
+  QString _fileName;
+  /** If @c true, the transfer was packed into @c _fileName. */
+  bool _packed;
+  /** The files to send. */
+  QVector<TransferEntry> _entries;
+  /** The header and manifest of the transfer. */
+  QByteArray _prefix;
+  qint64 _size;
+  int _numFiles;
+  qint64 _contentSize;
+  QString _error;
+};
+
+
+/** Reads an uncompressed transfer (see @c TransferEncoder) directly from the files. The chunks
+ * are read and hashed as the transfer is read. The files must not change in the meantime. */
+class TransferReader : public QIODevice
+{
+  Q_OBJECT
+
+public:
+  /** Constructor.
+   * @param prefix Specifies the header and manifest of the transfer.
+   * @param entries Specifies the files to send. */
+  TransferReader(const QByteArray &prefix, const QVector<TransferEntry> &entries,
+                 QObject *parent=0);
+
+  bool isSequential() const;
+
+protected:
+  qint64 readData(char *data, qint64 maxlen);
+  qint64 writeData(const char *data, qint64 len);
+  /** Serializes the next record into the buffer, the buffer stays empty at the end. */
+  bool _next();
+
+protected:
+  QVector<TransferEntry> _entries;
+  /** The index of the current file. */
+  int _index;
+  QFile _file;
+  /** The Merkle tree of the current file. */
+  MerkleTree _tree;
+  /** Bytes of the current file not read yet. */
+  qint64 _remaining;
+  /** The current record. */
+  QByteArray _buffer;
+  /** Bytes of the current record read already. */
+  int _offset;
+  /** Read buffer for a chunk. */
+  QByteArray _chunk;
+  /** Set once reading failed. */
+  bool _failed;
+};
+
+
+/** Unpacks a received file transfer (see @c TransferEncoder) while it is received. Each chunk
+ * is verified against its hash and each file against the root of its Merkle tree. Files that
+ * fail the verification are received completely but reported as corrupt. */
+class TransferDecoder
+{
+public:
+  /** Constructor.
+   * @param path Specifies the file to save a single file into. Several files (or a directory)
+   *        are saved into a directory of that name. */
+  TransferDecoder(const QString &path);
+
+  /** Processes the received data. Returns @c false on error. */
+  bool put(const uint8_t *data, size_t len);
+  /** Returns @c true if all files have been received. */
+  bool isComplete() const;
+  /** Returns the number of files in the transfer (once the manifest is received). */
+  int numFiles() const;
+  /** Returns the number of files received completely. */
+  int filesReceived() const;
+  /** Returns the number of content bytes written. */
+  qint64 contentSize() const;
+  /** Returns the names of the files that failed the verification. */
+  const QStringList &corruptFiles() const;
+  /** Returns a description of the error. */
+  const QString &errorString() const;
+  /** Closes the file. */
+  void close();
+
+protected:
+  /** Processes a single record. */
+  bool _record(uint8_t type, uint8_t flags, const char *payload, size_t len);
+  /** Processes a part of the manifest. */
+  bool _manifest(const char *payload, size_t len);
+  /** Opens the next file. */
+  bool _open(quint32 index);
+  /** Closes the current file and verifies it against the root of its Merkle tree. */
+  bool _close(const char *payload, size_t len);
+  /** Sets the error and closes the file. */
+  bool _fail(const QString &error);
+
+protected:
+  /** A file listed in the manifest. */
+  typedef struct {
+    QString name;
+    qint64 size;
+  } Entry;
+
+protected:
+  QString _path;
+  /** If @c true, the files are saved into the directory @c _path. */
+  bool _batch;
+  /** The files of the transfer. */
+  QVector<Entry> _entries;
+  /** The index of the file being received or -1. */
+  int _current;
+  /** The number of files received completely. */
+  int _received;
+  QFile _file;
+  /** The Merkle tree of the current file. */
+  MerkleTree _tree;
+  /** The index of the next chunk of the current file. */
+  quint32 _chunk;
+  /** The number of bytes written to the current file. */
+  qint64 _written;
+  /** If @c true, a chunk of the current file failed the verification. */
+  bool _corrupt;
+  /** The files, that failed the verification. */
+  QStringList _corruptFiles;
+  /** Received data, not processed yet (incomplete records). */
+  QByteArray _buffer;
+  /** The compression method of the transfer. */
+  int _method;
+  bool _complete;
+  qint64 _contentSize;
+  QString _error;
+};
+
+#endif // TRANSFER_H
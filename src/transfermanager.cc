@@ -0,0 +1,636 @@
+#include "transfermanager.hh"
+#include "application.hh"
+#include <ovlnet/logger.hh>
+#include <QFileInfo>
+#include <QIcon>
+#include <algorithm>
+
+// Interval (ms) of the progress and rate updates
+#define TRANSFER_UPDATE_INTERVAL 1000
+// Weight of the latest sample of the smoothed rate
+#define TRANSFER_RATE_WEIGHT     0.3
+
+
+/* ********************************************************************************************* *
+ * Implementation of Transfer
+ * ********************************************************************************************* */
+Transfer::Transfer(Application &app, Direction direction, QObject *parent)
+  : QObject(parent), _application(app), _direction(direction), _state(CONNECTING), _name(),
+    _message(), _size(0), _bytes(0), _sampled(0), _rate(0), _streamOpen(false)
+{
+  // pass...
+}
+
+Transfer::~Transfer() {
+  _streamClosed();
+}
+
+Transfer::Direction
+Transfer::direction() const {
+  return _direction;
+}
+
+Transfer::State
+Transfer::state() const {
+  return _state;
+}
+
+bool
+Transfer::isFinished() const {
+  return (COMPLETED == _state) || (FAILED == _state);
+}
+
+const QString &
+Transfer::name() const {
+  return _name;
+}
+
+const QString &
+Transfer::message() const {
+  return _message;
+}
+
+qint64
+Transfer::size() const {
+  return _size;
+}
+
+qint64
+Transfer::bytesTransferred() const {
+  return _bytes;
+}
+
+double
+Transfer::rate() const {
+  return _rate;
+}
+
+void
+Transfer::sample(double dt) {
+  if (dt <= 0) { return; }
+  double rate = (_bytes-_sampled)/dt;
+  _sampled = _bytes;
+  if (RUNNING != _state) { _rate = 0; return; }
+  _rate = TRANSFER_RATE_WEIGHT*rate + (1-TRANSFER_RATE_WEIGHT)*_rate;
+}
+
+void
+Transfer::_setState(State state, const QString &message) {
+  _state = state;
+  _message = message;
+  // Count the stream as closed as soon as the transfer is done, not once it is removed
+  if (isFinished()) { _streamClosed(); }
+  emit stateChanged();
+}
+
+void
+Transfer::_streamOpened() {
+  if (_streamOpen) { return; }
+  _streamOpen = true;
+  _application.metrics().streamOpened((UPLOAD == _direction) ? Metrics::UPLOAD : Metrics::DOWNLOAD);
+}
+
+void
+Transfer::_streamClosed() {
+  if (! _streamOpen) { return; }
+  _streamOpen = false;
+  _application.metrics().streamClosed((UPLOAD == _direction) ? Metrics::UPLOAD : Metrics::DOWNLOAD);
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of Upload
+ * ********************************************************************************************* */
+Upload::Upload(Application &app, const QStringList &paths, const Identifier &peer,
+               QObject *parent)
+  : Transfer(app, UPLOAD, parent), _peer(peer), _encoder(0), _upload(0), _source(0),
+    _pending(0), _pendingOffset(0)
+{
+  _name = QFileInfo(paths.first()).fileName();
+  if (paths.size() > 1) { _name = tr("%1 files").arg(paths.size()); }
+  _state = PACKING; _message = tr("Packing...");
+  _encoder = new TransferEncoder(
+        paths, peer, _application.settings().fileTransferSettings().compress(), this);
+  connect(_encoder, SIGNAL(finished(bool)), this, SLOT(_onPacked(bool)));
+  _encoder->start();
+}
+
+Upload::~Upload() {
+  if (_upload) {
+    _application.cancelStream(_upload);
+    delete _upload;
+  }
+  // Removes the packed file
+  delete _source;
+  delete _encoder;
+}
+
+const Identifier &
+Upload::peer() const {
+  return _peer;
+}
+
+FileUpload *
+Upload::stream() const {
+  return _upload;
+}
+
+void
+Upload::start() {
+  if (QUEUED != _state) { return; }
+  _upload = new FileUpload(_application.dht(), _encoder->fileName(), _size);
+  connect(_upload, SIGNAL(accepted()), this, SLOT(_onAccepted()));
+  connect(_upload, SIGNAL(closed()), this, SLOT(_onClosed()));
+  connect(_upload, SIGNAL(bytesWritten(size_t)), this, SLOT(_onBytesWritten(size_t)));
+  _streamOpened();
+  _setState(CONNECTING, tr("Connecting..."));
+  _application.connectUpload(_upload, _peer);
+}
+
+void
+Upload::run() {
+  if (ACCEPTED != _state) { return; }
+  _setState(RUNNING, tr("Uploading..."));
+  _sendNext();
+}
+
+void
+Upload::notFound() {
+  if (isFinished()) { return; }
+  _finish(FAILED, tr("Node not reachable."));
+}
+
+void
+Upload::pause() {
+  if (RUNNING != _state) { return; }
+  // Stop feeding the stream, it stays open
+  _setState(PAUSED, tr("Paused"));
+}
+
+void
+Upload::resume() {
+  if (PAUSED != _state) { return; }
+  _setState(RUNNING, tr("Uploading..."));
+  _sendNext();
+}
+
+void
+Upload::stop() {
+  if (isFinished()) { return; }
+  _finish(FAILED, tr("Canceled."));
+}
+
+void
+Upload::_onPacked(bool success) {
+  // The encoder (and a packed file) of a canceled upload is deleted by the destructor
+  if (PACKING != _state) { return; }
+  if (! success) {
+    logError() << "Cannot send file: " << _encoder->errorString();
+    _setState(FAILED, _encoder->errorString());
+    return;
+  }
+  _size = _encoder->size();
+  if (_encoder->numFiles() > 1) {
+    _name = tr("%1 (%2 files)").arg(QFileInfo(_encoder->fileName()).fileName())
+        .arg(_encoder->numFiles());
+  }
+  _setState(QUEUED, tr("Queued"));
+}
+
+void
+Upload::_onAccepted() {
+  if (CONNECTING != _state) { return; }
+  if (0 == (_source = _encoder->open())) {
+    _finish(FAILED, _encoder->errorString());
+    return;
+  }
+  logDebug() << "Transfer of file " << _encoder->fileName() << " accepted.";
+  // The manager starts sending once a slot is free
+  _setState(ACCEPTED, tr("Accepted, waiting for a free slot"));
+}
+
+void
+Upload::_onClosed() {
+  if (isFinished()) { return; }
+  if (_bytes == _size) {
+    _finish(COMPLETED, tr("Complete"));
+  } else {
+    _finish(FAILED, tr("Aborted."));
+  }
+}
+
+void
+Upload::_onBytesWritten(size_t bytes) {
+  // Called for every packet, just count the bytes
+  _bytes += bytes;
+  _application.metrics().transferred(Metrics::UPLOAD, bytes);
+  if (_size == _bytes) {
+    _finish(COMPLETED, tr("Complete"));
+    return;
+  }
+  if (RUNNING == _state) {
+    _sendNext();
+  }
+}
+
+void
+Upload::_sendNext() {
+  if (0 == _source) { return; }
+  while (_upload->free()) {
+    if (0 == _pending) {
+      qint64 len = _source->read((char *) _buffer, FILETRANSFER_MAX_DATA_LEN);
+      if (0 > len) {
+        logError() << "Cannot send file: " << _source->errorString();
+        _finish(FAILED, _source->errorString());
+        return;
+      }
+      if (0 == len) { break; }
+      _pending = len; _pendingOffset = 0;
+    }
+    // Do not write more than the stream can take, the rest is kept for later
+    qint64 written = _upload->write(_buffer + _pendingOffset,
+                                    std::min<size_t>(_pending, _upload->free()));
+    if (written <= 0) { break; }
+    _pending -= written; _pendingOffset += written;
+  }
+}
+
+void
+Upload::_finish(State state, const QString &message) {
+  // Set the final state first, stopping the stream emits closed()
+  _setState(state, message);
+  delete _source;
+  _source = 0;
+  // A stream still waiting for the node lookup has not been started yet
+  if (_upload && (! _application.cancelStream(_upload)) &&
+      (FileUpload::TERMINATED != _upload->state())) {
+    _upload->stop();
+  }
+  // Removes the packed file early
+  delete _encoder;
+  _encoder = 0;
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of Download
+ * ********************************************************************************************* */
+Download::Download(Application &app, FileDownload *download, QObject *parent)
+  : Transfer(app, DOWNLOAD, parent), _download(download), _decoder(0)
+{
+  _name = tr("Incoming transfer");
+  _message = tr("Connecting...");
+  connect(_download, SIGNAL(request(QString,uint64_t)),
+          this, SLOT(_onRequest(QString,uint64_t)));
+  connect(_download, SIGNAL(readyRead()), this, SLOT(_onReadyRead()));
+  connect(_download, SIGNAL(closed()), this, SLOT(_onClosed()));
+  _streamOpened();
+}
+
+Download::~Download() {
+  delete _decoder;
+  delete _download;
+}
+
+void
+Download::accept(const QString &path) {
+  if (REQUESTED != _state) { return; }
+  // The files get opened as soon as they are received
+  _decoder = new TransferDecoder(path);
+  _name = QFileInfo(path).fileName();
+  _setState(RUNNING, tr("Downloading..."));
+  _download->accept();
+}
+
+void
+Download::pause() {
+  if (RUNNING != _state) { return; }
+  // Received data stays in the stream, the sender stalls once its window is full
+  _setState(PAUSED, tr("Paused"));
+}
+
+void
+Download::resume() {
+  if (PAUSED != _state) { return; }
+  _setState(RUNNING, tr("Downloading..."));
+  _onReadyRead();
+}
+
+void
+Download::stop() {
+  if (isFinished()) { return; }
+  // Set the final state first, stopping the stream emits closed()
+  _setState(FAILED, (REQUESTED == _state) ? tr("Declined.") : tr("Canceled."));
+  if (_decoder) { _decoder->close(); }
+  _download->stop();
+}
+
+void
+Download::_onRequest(const QString &filename, uint64_t size) {
+  _name = filename;
+  _size = size;
+  _setState(REQUESTED, tr("Waiting for acceptance"));
+}
+
+void
+Download::_onReadyRead() {
+  // No logging here, this is called for every packet
+  if (RUNNING != _state) { return; }
+  while (_download->available()) {
+    size_t len = _download->read(_buffer, FILETRANSFER_MAX_DATA_LEN);
+    if (! _decoder->put(_buffer, len)) {
+      logError() << "Cannot receive file: " << _decoder->errorString();
+      _setState(FAILED, _decoder->errorString());
+      _download->stop();
+      return;
+    }
+    _bytes += len;
+    _application.metrics().transferred(Metrics::DOWNLOAD, len);
+  }
+  if (_bytes < _size) { return; }
+
+  // Check download complete, files failing the verification cannot be requested again
+  if (! _decoder->isComplete()) {
+    _decoder->close();
+    _setState(FAILED, tr("Incomplete."));
+  } else if (1 == _decoder->corruptFiles().size()) {
+    _setState(FAILED, tr("\"%1\" is corrupt.").arg(_decoder->corruptFiles().first()));
+  } else if (_decoder->corruptFiles().size()) {
+    _setState(FAILED, tr("%1 files are corrupt (see log).").arg(_decoder->corruptFiles().size()));
+  } else if (_decoder->numFiles() > 1) {
+    _setState(COMPLETED, tr("%1 files complete").arg(_decoder->numFiles()));
+  } else {
+    _setState(COMPLETED, tr("Complete"));
+  }
+}
+
+void
+Download::_onClosed() {
+  if (_decoder) { _decoder->close(); }
+  if (isFinished()) { return; }
+  _setState(FAILED, tr("Aborted."));
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of TransferManager
+ * ********************************************************************************************* */
+TransferManager::TransferManager(Application &app, QObject *parent)
+  : QAbstractTableModel(parent), _application(app), _transfers(), _updateTimer(), _lastUpdate(),
+    _scheduling(false), _reschedule(false)
+{
+  // Update progress and rates periodically rather than for every packet
+  _updateTimer.setInterval(TRANSFER_UPDATE_INTERVAL);
+  _updateTimer.setSingleShot(false);
+  connect(&_updateTimer, SIGNAL(timeout()), this, SLOT(_onUpdate()));
+  _updateTimer.start();
+  _lastUpdate.start();
+
+  connect(&_application.settings().fileTransferSettings(), SIGNAL(modified()),
+          this, SLOT(_schedule()));
+}
+
+TransferManager::~TransferManager() {
+  QVector<Transfer *>::iterator transfer = _transfers.begin();
+  for (; transfer != _transfers.end(); transfer++) {
+    delete *transfer;
+  }
+}
+
+void
+TransferManager::upload(const QStringList &paths, const Identifier &peer) {
+  if (paths.isEmpty()) { return; }
+  _add(new Upload(_application, paths, peer));
+}
+
+void
+TransferManager::download(FileDownload *download) {
+  _add(new Download(_application, download));
+}
+
+void
+TransferManager::notFound(FileUpload *upload) {
+  for (int i=0; i<_transfers.size(); i++) {
+    Upload *transfer = qobject_cast<Upload *>(_transfers[i]);
+    if (transfer && (upload == transfer->stream())) {
+      transfer->notFound();
+      return;
+    }
+  }
+}
+
+size_t
+TransferManager::numTransfers() const {
+  return _transfers.size();
+}
+
+Transfer *
+TransferManager::transfer(int idx) const {
+  if ((idx < 0) || (idx >= _transfers.size())) { return 0; }
+  return _transfers[idx];
+}
+
+void
+TransferManager::clearFinished() {
+  for (int i=_transfers.size()-1; i>=0; i--) {
+    if (! _transfers[i]->isFinished()) { continue; }
+    beginRemoveRows(QModelIndex(), i, i);
+    // May be called from a signal of the transfer
+    _transfers[i]->deleteLater();
+    _transfers.remove(i);
+    endRemoveRows();
+  }
+}
+
+double
+TransferManager::rate(Transfer::Direction direction) const {
+  double rate = 0;
+  QVector<Transfer *>::const_iterator transfer = _transfers.begin();
+  for (; transfer != _transfers.end(); transfer++) {
+    if (direction == (*transfer)->direction()) {
+      rate += (*transfer)->rate();
+    }
+  }
+  return rate;
+}
+
+double
+TransferManager::eta() const {
+  // The longest remaining running transfer determines the total
+  double eta = -1;
+  QVector<Transfer *>::const_iterator transfer = _transfers.begin();
+  for (; transfer != _transfers.end(); transfer++) {
+    if (Transfer::RUNNING != (*transfer)->state()) { continue; }
+    if ((*transfer)->rate() <= 0) { return -1; }
+    double remaining = ((*transfer)->size() - (*transfer)->bytesTransferred())/(*transfer)->rate();
+    eta = std::max(eta, remaining);
+  }
+  return eta;
+}
+
+QString
+TransferManager::formatRate(double rate) {
+  if (rate < 2000.0) {
+    return QString("%1b/s").arg(QString::number(rate, 'f', 1));
+  }
+  if (rate < 2e6) {
+    return QString("%1kb/s").arg(QString::number(rate/1000., 'f', 1));
+  }
+  return QString("%1Mb/s").arg(QString::number(rate/1e6, 'f', 1));
+}
+
+QString
+TransferManager::formatTime(double seconds) {
+  if (seconds < 0) { return tr("unknown"); }
+  qint64 s = qint64(seconds+0.5);
+  if (s < 3600) {
+    return QString("%1:%2").arg(s/60).arg(s%60, 2, 10, QChar('0'));
+  }
+  return QString("%1:%2:%3").arg(s/3600).arg((s/60)%60, 2, 10, QChar('0'))
+      .arg(s%60, 2, 10, QChar('0'));
+}
+
+void
+TransferManager::_add(Transfer *transfer) {
+  connect(transfer, SIGNAL(stateChanged()), this, SLOT(_onStateChanged()));
+  beginInsertRows(QModelIndex(), _transfers.size(), _transfers.size());
+  _transfers.append(transfer);
+  endInsertRows();
+}
+
+void
+TransferManager::_onStateChanged() {
+  Transfer *transfer = qobject_cast<Transfer *>(sender());
+  int idx = _transfers.indexOf(transfer);
+  if (idx < 0) { return; }
+  emit dataChanged(index(idx, 0), index(idx, columnCount(QModelIndex())-1));
+  switch (transfer->state()) {
+  case Transfer::REQUESTED:
+    emit requested();
+    break;
+  default:
+    // An upload is ready or a slot may have become free
+    _schedule();
+    break;
+  }
+}
+
+void
+TransferManager::_schedule() {
+  // Starting an upload changes its state, which requests scheduling again
+  if (_scheduling) { _reschedule = true; return; }
+  _scheduling = true;
+  do {
+    _reschedule = false;
+    int sending = 0, offered = 0;
+    QVector<Transfer *>::iterator transfer = _transfers.begin();
+    for (; transfer != _transfers.end(); transfer++) {
+      if (Transfer::UPLOAD != (*transfer)->direction()) { continue; }
+      switch ((*transfer)->state()) {
+      // Paused uploads keep their slot, hence resuming never exceeds the limit
+      case Transfer::RUNNING:
+      case Transfer::PAUSED: sending++; break;
+      case Transfer::CONNECTING:
+      case Transfer::ACCEPTED: offered++; break;
+      default: break;
+      }
+    }
+
+    int limit = _application.settings().fileTransferSettings().maxActive();
+    // Let accepted uploads send first
+    for (int i=0; (i<_transfers.size()) && (sending<limit); i++) {
+      Upload *upload = qobject_cast<Upload *>(_transfers[i]);
+      if ((0 == upload) || (Transfer::ACCEPTED != upload->state())) { continue; }
+      upload->run();
+      sending++; offered--;
+    }
+    // Then offer queued uploads
+    for (int i=0; (i<_transfers.size()) && (offered<limit); i++) {
+      Upload *upload = qobject_cast<Upload *>(_transfers[i]);
+      if ((0 == upload) || (Transfer::QUEUED != upload->state())) { continue; }
+      // Pending streams are kept per node, wait until the node of a pending one is found
+      if (_application.isPending(upload->peer())) { continue; }
+      upload->start();
+      offered++;
+    }
+  } while (_reschedule);
+  _scheduling = false;
+}
+
+void
+TransferManager::_onUpdate() {
+  // Node lookups finish without a state change, retry uploads waiting for them
+  _schedule();
+  double dt = _lastUpdate.restart()/1000.;
+  QVector<Transfer *>::iterator transfer = _transfers.begin();
+  for (; transfer != _transfers.end(); transfer++) {
+    (*transfer)->sample(dt);
+  }
+  if (_transfers.size()) {
+    emit dataChanged(index(0, 2), index(_transfers.size()-1, columnCount(QModelIndex())-1));
+  }
+  emit updated();
+}
+
+int
+TransferManager::rowCount(const QModelIndex &parent) const {
+  if (parent.isValid()) { return 0; }
+  return _transfers.size();
+}
+
+int
+TransferManager::columnCount(const QModelIndex &parent) const {
+  return 5;
+}
+
+QVariant
+TransferManager::data(const QModelIndex &index, int role) const {
+  if (! index.isValid()) { return QVariant(); }
+  if (index.row() >= _transfers.size()) { return QVariant(); }
+
+  Transfer *transfer = _transfers[index.row()];
+  if ((Qt::DecorationRole == role) && (0 == index.column())) {
+    if (Transfer::UPLOAD == transfer->direction()) {
+      return QIcon("://icons/data-transfer-upload.png");
+    }
+    return QIcon("://icons/data-transfer-download.png");
+  }
+  // Progress in percent, drawn as a progress bar by the view
+  if ((Qt::UserRole == role) && (2 == index.column())) {
+    if (Transfer::COMPLETED == transfer->state()) { return 100; }
+    if (0 == transfer->size()) { return 0; }
+    return int(100*double(transfer->bytesTransferred())/transfer->size());
+  }
+  if (Qt::DisplayRole != role) { return QVariant(); }
+
+  switch (index.column()) {
+  case 0: return transfer->name();
+  case 1: return transfer->message();
+  case 2:
+    if (0 == transfer->size()) { return QString(); }
+    return QString("%1%").arg(data(index, Qt::UserRole).toInt());
+  case 3:
+    if (Transfer::RUNNING != transfer->state()) { return QString(); }
+    return formatRate(transfer->rate());
+  case 4:
+    if (Transfer::RUNNING != transfer->state()) { return QString(); }
+    if (transfer->rate() <= 0) { return tr("unknown"); }
+    return formatTime((transfer->size()-transfer->bytesTransferred())/transfer->rate());
+  default: break;
+  }
+  return QVariant();
+}
+
+QVariant
+TransferManager::headerData(int section, Qt::Orientation orientation, int role) const {
+  if ((Qt::Horizontal != orientation) || (Qt::DisplayRole != role)) { return QVariant(); }
+  switch (section) {
+  case 0: return tr("File");
+  case 1: return tr("Status");
+  case 2: return tr("Progress");
+  case 3: return tr("Rate");
+  case 4: return tr("Remaining");
+  default: break;
+  }
+  return QVariant();
+}
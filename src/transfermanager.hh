@@ -0,0 +1,267 @@
+#ifndef TRANSFERMANAGER_H
+#define TRANSFERMANAGER_H
+
+#include <QAbstractTableModel>
+#include <QVector>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QIODevice>
+#include <ovlnet/filetransfer.hh>
+#include "transfer.hh"
+
+// forward declarations
+class Application;
+
+
+/** Base of all file transfers. A transfer only counts the bytes transferred, the progress and
+ * rate are sampled periodically by the @c TransferManager. */
+class Transfer : public QObject
+{
+  Q_OBJECT
+
+public:
+  /** The direction of a transfer. */
+  typedef enum {
+    UPLOAD,
+    DOWNLOAD
+  } Direction;
+
+  /** The possible states of a transfer. */
+  typedef enum {
+    PACKING,    ///< The files to upload get packed.
+    QUEUED,     ///< The upload waits for a free slot.
+    CONNECTING, ///< Connecting to the node, waiting for the transfer to be accepted.
+    ACCEPTED,   ///< The upload was accepted and waits for a free slot.
+    REQUESTED,  ///< The download waits to be accepted.
+    RUNNING,    ///< Transferring.
+    PAUSED,     ///< Paused by the user.
+    COMPLETED,  ///< The transfer is complete.
+    FAILED      ///< The transfer failed or was canceled.
+  } State;
+
+protected:
+  /** Hidden constructor. */
+  Transfer(Application &app, Direction direction, QObject *parent=0);
+
+public:
+  /** Destructor. */
+  virtual ~Transfer();
+
+  /** Returns the direction of the transfer. */
+  Direction direction() const;
+  /** Returns the state of the transfer. */
+  State state() const;
+  /** Returns @c true if the transfer is complete or failed. */
+  bool isFinished() const;
+  /** Returns the name of the file (or directory) transferred. */
+  const QString &name() const;
+  /** Returns a description of the current state. */
+  const QString &message() const;
+  /** Returns the size of the transfer in bytes (as sent). */
+  qint64 size() const;
+  /** Returns the number of bytes transferred. */
+  qint64 bytesTransferred() const;
+  /** Returns the smoothed transfer rate in bytes per second. */
+  double rate() const;
+
+  /** Pauses a running transfer. */
+  virtual void pause() = 0;
+  /** Resumes a paused transfer. */
+  virtual void resume() = 0;
+  /** Cancels the transfer. */
+  virtual void stop() = 0;
+
+  /** Updates the transfer rate, gets called periodically by the manager.
+   * @param dt Specifies the time in seconds since the last call. */
+  void sample(double dt);
+
+signals:
+  /** Gets emitted if the state of the transfer changed. */
+  void stateChanged();
+
+protected:
+  /** Updates the state and the description. Once finished, the stream is counted as closed. */
+  void _setState(State state, const QString &message);
+  /** Counts the stream of the transfer as opened in the metrics. */
+  void _streamOpened();
+  /** Counts the stream of the transfer as closed in the metrics, if it was opened. */
+  void _streamClosed();
+
+protected:
+  Application &_application;
+  Direction _direction;
+  State _state;
+  QString _name;
+  QString _message;
+  qint64 _size;
+  qint64 _bytes;
+  /** Bytes transferred at the last sample. */
+  qint64 _sampled;
+  double _rate;
+  /** If @c true, the stream is counted as open in the metrics. */
+  bool _streamOpen;
+};
+
+
+/** Uploads files (see @c TransferEncoder) to a node. */
+class Upload : public Transfer
+{
+  Q_OBJECT
+
+public:
+  /** Constructor, starts packing the given files or directory. */
+  Upload(Application &app, const QStringList &paths, const Identifier &peer, QObject *parent=0);
+  /** Destructor. */
+  virtual ~Upload();
+
+  /** Returns the node, the files are sent to. */
+  const Identifier &peer() const;
+  /** Returns the stream or 0 if not connected yet. */
+  FileUpload *stream() const;
+
+  /** Connects to the node, gets called by the manager once the upload may be offered. */
+  void start();
+  /** Starts sending an accepted upload, gets called by the manager once a slot is free. */
+  void run();
+  /** Gets called if the node cannot be found. */
+  void notFound();
+
+  void pause();
+  void resume();
+  void stop();
+
+protected slots:
+  void _onPacked(bool success);
+  void _onAccepted();
+  void _onClosed();
+  void _onBytesWritten(size_t bytes);
+
+protected:
+  /** Sends as much of the transfer as the stream can take. */
+  void _sendNext();
+  /** Releases the stream and the packed file and sets the final state. */
+  void _finish(State state, const QString &message);
+
+protected:
+  Identifier _peer;
+  /** Prepares the transfer, kept until the upload is finished. */
+  TransferEncoder *_encoder;
+  FileUpload *_upload;
+  /** Reads the transfer, opened once accepted. */
+  QIODevice *_source;
+  /** Packet buffer, reused for every packet. */
+  uint8_t _buffer[FILETRANSFER_MAX_DATA_LEN];
+  /** Bytes in the packet buffer not written yet. */
+  size_t _pending;
+  /** Offset of these bytes. */
+  size_t _pendingOffset;
+};
+
+
+/** Receives files (see @c TransferDecoder) from a node. */
+class Download : public Transfer
+{
+  Q_OBJECT
+
+public:
+  /** Constructor, takes the ownership of the stream. */
+  Download(Application &app, FileDownload *download, QObject *parent=0);
+  /** Destructor. */
+  virtual ~Download();
+
+  /** Accepts the transfer and saves the file (or files) at the given path. */
+  void accept(const QString &path);
+
+  void pause();
+  void resume();
+  void stop();
+
+protected slots:
+  void _onRequest(const QString &filename, uint64_t size);
+  void _onReadyRead();
+  void _onClosed();
+
+protected:
+  FileDownload *_download;
+  /** Unpacks the received files, created once the transfer is accepted. */
+  TransferDecoder *_decoder;
+  /** Packet buffer, reused for every packet. */
+  uint8_t _buffer[FILETRANSFER_MAX_DATA_LEN];
+};
+
+
+/** Holds all file transfers of the client. Uploads are queued and at most as many uploads as
+ * set in the @c FileTransferSettings send data at a time (running or paused ones), the same
+ * number of uploads may be offered to their nodes meanwhile. The progress and rates are
+ * sampled once a second rather than for every packet. */
+class TransferManager : public QAbstractTableModel
+{
+  Q_OBJECT
+
+public:
+  /** Constructor. */
+  explicit TransferManager(Application &app, QObject *parent=0);
+  /** Destructor. */
+  virtual ~TransferManager();
+
+  /** Queues an upload of the given files (or a single directory) to the given node. */
+  void upload(const QStringList &paths, const Identifier &peer);
+  /** Adds an incoming transfer, takes the ownership of the stream. */
+  void download(FileDownload *download);
+  /** Gets called if the node of an upload cannot be found. */
+  void notFound(FileUpload *upload);
+
+  /** Returns the number of transfers. */
+  size_t numTransfers() const;
+  /** Returns the transfer at the given index. */
+  Transfer *transfer(int idx) const;
+  /** Removes all complete and failed transfers. */
+  void clearFinished();
+
+  /** Returns the total rate (bytes per second) of all transfers in the given direction. */
+  double rate(Transfer::Direction direction) const;
+  /** Returns the estimated time in seconds until all running transfers are complete or -1 if
+   * unknown. */
+  double eta() const;
+
+  /** Formats a transfer rate. */
+  static QString formatRate(double rate);
+  /** Formats a remaining time in seconds. */
+  static QString formatTime(double seconds);
+
+  // Implementation of QAbstractTableModel
+  int rowCount(const QModelIndex &parent) const;
+  int columnCount(const QModelIndex &parent) const;
+  QVariant data(const QModelIndex &index, int role) const;
+  QVariant headerData(int section, Qt::Orientation orientation, int role) const;
+
+signals:
+  /** Gets emitted if an incoming transfer waits to be accepted. */
+  void requested();
+  /** Gets emitted once the rates have been updated. */
+  void updated();
+
+protected slots:
+  void _onStateChanged();
+  void _onUpdate();
+  /** Starts accepted and queued uploads as long as the limits are not reached. */
+  void _schedule();
+
+protected:
+  /** Appends a transfer. */
+  void _add(Transfer *transfer);
+
+protected:
+  Application &_application;
+  QVector<Transfer *> _transfers;
+  /** Samples the progress and rates. */
+  QTimer _updateTimer;
+  /** Measures the time since the last sample. */
+  QElapsedTimer _lastUpdate;
+  /** Set while scheduling, as starting an upload changes its state. */
+  bool _scheduling;
+  /** Set if scheduling was requested while scheduling. */
+  bool _reschedule;
+};
+
+#endif // TRANSFERMANAGER_H
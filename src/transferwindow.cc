@@ -0,0 +1,156 @@
+#include "transferwindow.hh"
+#include "application.hh"
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+#include <QHeaderView>
+#include <QApplication>
+#include <QStyle>
+#include <QStyleOption>
+#include <QFileDialog>
+#include <QCloseEvent>
+
+
+/* ********************************************************************************************* *
+ * Implementation of TransferProgressDelegate
+ * ********************************************************************************************* */
+TransferProgressDelegate::TransferProgressDelegate(QObject *parent)
+  : QStyledItemDelegate(parent)
+{
+  // pass...
+}
+
+void
+TransferProgressDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option,
+                                const QModelIndex &index) const
+{
+  QStyleOptionProgressBar bar;
+  bar.rect = option.rect.adjusted(1, 1, -1, -1);
+  bar.minimum = 0;
+  bar.maximum = 100;
+  bar.progress = index.data(Qt::UserRole).toInt();
+  bar.text = index.data(Qt::DisplayRole).toString();
+  bar.textVisible = true;
+  QApplication::style()->drawControl(QStyle::CE_ProgressBar, &bar, painter);
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of TransferWindow
+ * ********************************************************************************************* */
+TransferWindow::TransferWindow(Application &app, QWidget *parent)
+  : QWidget(parent), _application(app), _transfers(app.transfers())
+{
+  setWindowTitle(tr("File transfers"));
+  setMinimumWidth(640);
+
+  _total = new QLabel();
+
+  _table = new QTableView();
+  _table->setModel(&_transfers);
+  _table->setItemDelegateForColumn(2, new TransferProgressDelegate(_table));
+  _table->setSelectionBehavior(QAbstractItemView::SelectRows);
+  _table->setSelectionMode(QAbstractItemView::SingleSelection);
+  _table->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+  _table->verticalHeader()->hide();
+
+  _accept = new QPushButton(QIcon("://icons/circle-check.png"), tr("accept"));
+  _pause = new QPushButton(tr("pause"));
+  _stop = new QPushButton(QIcon("://icons/circle-x.png"), tr("stop"));
+  QPushButton *clear = new QPushButton(tr("clear finished"));
+
+  QVBoxLayout *layout = new QVBoxLayout();
+  layout->addWidget(_table, 1);
+  QHBoxLayout *bbox = new QHBoxLayout();
+  bbox->addWidget(_total, 1);
+  bbox->addWidget(_accept);
+  bbox->addWidget(_pause);
+  bbox->addWidget(_stop);
+  bbox->addWidget(clear);
+  layout->addLayout(bbox);
+  setLayout(layout);
+
+  connect(_accept, SIGNAL(clicked()), this, SLOT(_onAccept()));
+  connect(_pause, SIGNAL(clicked()), this, SLOT(_onPauseResume()));
+  connect(_stop, SIGNAL(clicked()), this, SLOT(_onStop()));
+  connect(clear, SIGNAL(clicked()), this, SLOT(_onClear()));
+  connect(_table, SIGNAL(doubleClicked(QModelIndex)), this, SLOT(_onAccept()));
+  connect(_table->selectionModel(), SIGNAL(selectionChanged(QItemSelection,QItemSelection)),
+          this, SLOT(_onSelectionChanged()));
+  // The buttons depend on the state of the selected transfer
+  connect(&_transfers, SIGNAL(dataChanged(QModelIndex,QModelIndex)),
+          this, SLOT(_onSelectionChanged()));
+  connect(&_transfers, SIGNAL(updated()), this, SLOT(_onUpdated()));
+
+  _onUpdated();
+  _onSelectionChanged();
+}
+
+Transfer *
+TransferWindow::_selected() const {
+  QModelIndexList items = _table->selectionModel()->selectedRows();
+  if (0 == items.size()) { return 0; }
+  return _transfers.transfer(items.first().row());
+}
+
+void
+TransferWindow::_onAccept() {
+  Download *download = qobject_cast<Download *>(_selected());
+  if ((0 == download) || (Transfer::REQUESTED != download->state())) { return; }
+  // Several files are saved into a directory of the given name
+  QString path = QFileDialog::getSaveFileName(this, tr("Save as"), download->name());
+  if (0 == path.size()) { return; }
+  download->accept(path);
+}
+
+void
+TransferWindow::_onPauseResume() {
+  Transfer *transfer = _selected();
+  if (0 == transfer) { return; }
+  if (Transfer::PAUSED == transfer->state()) {
+    transfer->resume();
+  } else {
+    transfer->pause();
+  }
+}
+
+void
+TransferWindow::_onStop() {
+  Transfer *transfer = _selected();
+  if (0 == transfer) { return; }
+  transfer->stop();
+}
+
+void
+TransferWindow::_onClear() {
+  _transfers.clearFinished();
+}
+
+void
+TransferWindow::_onUpdated() {
+  double up = _transfers.rate(Transfer::UPLOAD), down = _transfers.rate(Transfer::DOWNLOAD);
+  if ((0 == up) && (0 == down)) {
+    _total->setText(tr("No running transfers."));
+    return;
+  }
+  _total->setText(tr("Up: %1, down: %2, remaining: %3")
+                  .arg(TransferManager::formatRate(up))
+                  .arg(TransferManager::formatRate(down))
+                  .arg(TransferManager::formatTime(_transfers.eta())));
+}
+
+void
+TransferWindow::_onSelectionChanged() {
+  Transfer *transfer = _selected();
+  _accept->setEnabled(transfer && (Transfer::REQUESTED == transfer->state()));
+  _pause->setEnabled(transfer && ((Transfer::RUNNING == transfer->state()) ||
+                                  (Transfer::PAUSED == transfer->state())));
+  _pause->setText((transfer && (Transfer::PAUSED == transfer->state())) ?
+                    tr("resume") : tr("pause"));
+  _stop->setEnabled(transfer && (! transfer->isFinished()));
+}
+
+void
+TransferWindow::closeEvent(QCloseEvent *evt) {
+  evt->accept();
+  this->deleteLater();
+}
@@ -0,0 +1,59 @@
+#ifndef TRANSFERWINDOW_H
+#define TRANSFERWINDOW_H
+
+#include <QWidget>
+#include <QLabel>
+#include <QPushButton>
+#include <QTableView>
+#include <QStyledItemDelegate>
+#include "transfermanager.hh"
+
+class Application;
+
+
+/** Draws the progress of a transfer as a progress bar. */
+class TransferProgressDelegate : public QStyledItemDelegate
+{
+  Q_OBJECT
+
+public:
+  explicit TransferProgressDelegate(QObject *parent=0);
+
+  void paint(QPainter *painter, const QStyleOptionViewItem &option,
+             const QModelIndex &index) const;
+};
+
+
+/** Lists all file transfers of the client, replaces the dialogs of the single transfers. */
+class TransferWindow : public QWidget
+{
+  Q_OBJECT
+
+public:
+  explicit TransferWindow(Application &app, QWidget *parent=0);
+
+protected slots:
+  void _onAccept();
+  void _onPauseResume();
+  void _onStop();
+  void _onClear();
+  void _onUpdated();
+  void _onSelectionChanged();
+
+protected:
+  void closeEvent(QCloseEvent *evt);
+  /** Returns the selected transfer or 0. */
+  Transfer *_selected() const;
+
+protected:
+  Application &_application;
+  TransferManager &_transfers;
+
+  QLabel *_total;
+  QTableView *_table;
+  QPushButton *_accept;
+  QPushButton *_pause;
+  QPushButton *_stop;
+};
+
+#endif // TRANSFERWINDOW_H